@@ -1,4 +0,0 @@
-// Fill out your copyright notice in the Description page of Project Settings.
-
-
-#include "PrioritiyQueue.h"
\ No newline at end of file
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavObstacleComponent.h"
+#include "SixDOFNavmeshVolume.h"
+#include "EngineUtils.h"
+
+USixDOFNavObstacleComponent::USixDOFNavObstacleComponent()
+{
+	// Movement is picked up from transform events, so there is nothing to do per frame.
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void USixDOFNavObstacleComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	AActor* owner = GetOwner();
+	if (!volume) {
+		for (TActorIterator<ASixDOFNavmeshVolume> iterator(GetWorld()); iterator; ++iterator) {
+			if (iterator->GetComponentsBoundingBox(true).IsInsideOrOn(owner->GetActorLocation())) {
+				volume = *iterator;
+				break;
+			}
+		}
+	}
+	if (!volume) {
+		UE_LOG(LogTemp, Warning, TEXT("%s is not inside a 6DOF navmesh volume and will not be treated as an obstacle."), *owner->GetName());
+		return;
+	}
+
+	TArray<UPrimitiveComponent*> primitives;
+	owner->GetComponents(primitives);
+	for (UPrimitiveComponent* primitive : primitives) {
+		if (!primitive->IsQueryCollisionEnabled()) continue;
+
+		volume->AddDynamicObstacle(primitive);
+		registeredComponents.Add(primitive);
+	}
+}
+
+void USixDOFNavObstacleComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	if (IsValid(volume)) {
+		for (auto& primitive : registeredComponents) {
+			volume->RemoveDynamicObstacle(primitive.Get());
+		}
+	}
+	registeredComponents.Reset();
+}
@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SixDOFNavObstacleComponent.generated.h"
+
+class ASixDOFNavmeshVolume;
+
+// Marks its owner as a moving obstacle. The owner's colliding primitives are registered with a navmesh volume,
+// which rebuilds the cells under them whenever their transform events report that they moved far enough.
+UCLASS(ClassGroup = (Navigation), meta = (BlueprintSpawnableComponent))
+class SIXDOFNAVMESH_API USixDOFNavObstacleComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	USixDOFNavObstacleComponent();
+
+	// Volume to register with. When unset, the first volume containing the owner at BeginPlay is used.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Obstacle")
+		ASixDOFNavmeshVolume* volume;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> registeredComponents;
+};
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshData.h"
+#include "Serialization/MemoryWriter.h"
+
+void USixDOFNavmeshData::Serialize(FArchive& Ar) {
+	Super::Serialize(Ar);
+
+	Ar << version;
+	Ar << collisionHash;
+
+	// Written as a byte array so a loader can skip a bake with a different layout. Loading reads the octree straight
+	// out of the archive instead of going through an intermediate buffer.
+	if (Ar.IsSaving()) {
+		TArray<uint8> bytes;
+		FMemoryWriter writer(bytes);
+		octree.Serialize(writer);
+		Ar << bytes;
+	}
+	else if (Ar.IsLoading()) {
+		int32 numOfBytes = 0;
+		Ar << numOfBytes;
+
+		if (version == CurrentVersion) octree.Serialize(Ar);
+		else {
+			TArray<uint8> skipped;
+			skipped.SetNumUninitialized(numOfBytes);
+			Ar.Serialize(skipped.GetData(), numOfBytes);
+			octree.Empty();
+		}
+	}
+
+	// The tile headers are engine bulk data and do not depend on the octree's layout, so a stale bake still reads
+	// them to leave the archive where its export ends. Bakes from before tiling have none.
+	if (Ar.IsLoading() && version < FirstTiledVersion) {
+		tileSize = 0;
+		tiles.Empty();
+		return;
+	}
+
+	Ar << tileSize;
+	int32 numOfTiles = tiles.Num();
+	Ar << numOfTiles;
+	if (Ar.IsLoading()) {
+		tiles.Empty(numOfTiles);
+		for (int32 i = 0; i < numOfTiles; ++i) {
+			tiles.Add(new FSixDOFNavmeshTile());
+		}
+	}
+	for (int32 i = 0; i < tiles.Num(); ++i) {
+		tiles[i].bulkData.Serialize(Ar, this);
+	}
+
+	if (Ar.IsLoading() && version != CurrentVersion) {
+		tileSize = 0;
+		tiles.Empty();
+	}
+}
+
+bool USixDOFNavmeshData::IsUpToDate(const FSHAHash& hash) const {
+	return version == CurrentVersion && collisionHash == hash && octree.levels.Num() > 0;
+}
+
+void USixDOFNavmeshData::Store(const FSixDOFOctree& source, const FSHAHash& hash) {
+	version = CurrentVersion;
+	collisionHash = hash;
+	octree = source;
+	tileSize = 0;
+	tiles.Empty();
+}
+
+void USixDOFNavmeshData::StoreTiles(const FSixDOFOctree& source, const FSHAHash& hash, int32 inTileSize) {
+	version = CurrentVersion;
+	collisionHash = hash;
+	tileSize = inTileSize;
+
+	octree.Empty();
+	octree.InitBuffer(source);
+	octree.levels[0] = source.levels[0];
+	octree.links[0] = source.links[0];
+	octree.GrowLayers();
+	octree.clearance[0] = source.clearance[0];
+	for (int32 i = 0; i < octree.levels[0].Num(); ++i) {
+		FOctant& octant = octree.levels[0][i];
+		if (octant.firstChild == INDEX_NONE) continue;
+		if (octant.navigatable == ENavigabilityStatus::HasChildren || octant.navigatable == ENavigabilityStatus::HasSubvoxels) {
+			octant.navigatable = ENavigabilityStatus::Unloaded;
+		}
+		octant.firstChild = INDEX_NONE;
+	}
+
+	const FIntVector tileGridSize = GetTileGridSize(source.gridSize, tileSize);
+	const int32 numOfTiles = tileGridSize.X * tileGridSize.Y * tileGridSize.Z;
+
+	tiles.Empty(numOfTiles);
+	TArray<int32> topLevelIndices;
+	for (int32 i = 0; i < numOfTiles; ++i) {
+		GetTopLevelIndices(source.gridSize, tileSize, i, topLevelIndices);
+
+		FSixDOFOctree buffer;
+		buffer.Extract(source, topLevelIndices);
+
+		TArray<uint8> bytes;
+		FMemoryWriter writer(bytes);
+		buffer.Serialize(writer);
+
+		FSixDOFNavmeshTile* tile = new FSixDOFNavmeshTile();
+		tile->bulkData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+		tile->bulkData.Lock(LOCK_READ_WRITE);
+		FMemory::Memcpy(tile->bulkData.Realloc(bytes.Num()), bytes.GetData(), bytes.Num());
+		tile->bulkData.Unlock();
+		tiles.Add(tile);
+	}
+}
+
+FIntVector USixDOFNavmeshData::GetTileGridSize(const FIntVector& gridSize, int32 tileSize) {
+	return FIntVector(FMath::DivideAndRoundUp(gridSize.X, tileSize), FMath::DivideAndRoundUp(gridSize.Y, tileSize), FMath::DivideAndRoundUp(gridSize.Z, tileSize));
+}
+
+int32 USixDOFNavmeshData::GetTileIndex(const FIntVector& gridSize, int32 tileSize, const FIntVector& topLevelCoordinate) {
+	const FIntVector tileGridSize = GetTileGridSize(gridSize, tileSize);
+	const FIntVector tile = topLevelCoordinate / tileSize;
+	return (tile.X * tileGridSize.Y + tile.Y) * tileGridSize.Z + tile.Z;
+}
+
+void USixDOFNavmeshData::GetTopLevelIndices(const FIntVector& gridSize, int32 tileSize, int32 tileIndex, TArray<int32>& outIndices) {
+	const FIntVector tileGridSize = GetTileGridSize(gridSize, tileSize);
+	const FIntVector tile(tileIndex / (tileGridSize.Y * tileGridSize.Z), (tileIndex / tileGridSize.Z) % tileGridSize.Y, tileIndex % tileGridSize.Z);
+	const FIntVector first = tile * tileSize;
+	const FIntVector last(FMath::Min(first.X + tileSize, gridSize.X), FMath::Min(first.Y + tileSize, gridSize.Y), FMath::Min(first.Z + tileSize, gridSize.Z));
+
+	outIndices.Reset();
+	for (int32 x = first.X; x < last.X; ++x) {
+		for (int32 y = first.Y; y < last.Y; ++y) {
+			for (int32 z = first.Z; z < last.Z; ++z) {
+				outIndices.Add((x * gridSize.Y + y) * gridSize.Z + z);
+			}
+		}
+	}
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/BulkData.h"
+#include "SixDOFNavmeshOctree.h"
+#include "SixDOFNavmeshData.generated.h"
+
+// The subtrees of a cube of tileSize^3 top-level cells, serialized as an FSixDOFOctree buffer.
+// The payload stays on disk until the tile streamer asks for it.
+struct FSixDOFNavmeshTile
+{
+	FByteBulkData bulkData;
+};
+
+// An octree baked in the editor by ASixDOFNavmeshVolume::BakeNavmesh.
+// The node pools are stored as raw blocks, so loading costs one copy per pool rather than work per node.
+UCLASS(BlueprintType)
+class SIXDOFNAVMESH_API USixDOFNavmeshData : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// Bump whenever the layout of FOctant or FSixDOFOctree changes so older bakes are rebuilt instead of loaded.
+	static constexpr int32 CurrentVersion = 7;
+	// First version with the tile section after the octree.
+	static constexpr int32 FirstTiledVersion = 2;
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	bool IsUpToDate(const FSHAHash& hash) const;
+	void Store(const FSixDOFOctree& source, const FSHAHash& hash);
+	// Stores only the top level in octree, with every subdivided cell marked Unloaded, and each tile's subtrees
+	// as a separate payload. Portals are left out, since they point into subtrees that only get placed on load.
+	void StoreTiles(const FSixDOFOctree& source, const FSHAHash& hash, int32 inTileSize);
+
+	static FIntVector GetTileGridSize(const FIntVector& gridSize, int32 tileSize);
+	static int32 GetTileIndex(const FIntVector& gridSize, int32 tileSize, const FIntVector& topLevelCoordinate);
+	// Top-level cells of a tile in the order its payload stores them.
+	static void GetTopLevelIndices(const FIntVector& gridSize, int32 tileSize, int32 tileIndex, TArray<int32>& outIndices);
+
+	int32 version = CurrentVersion;
+	// Hash of everything the build reads: the volume's settings and the transforms, collision geometry and object
+	// types of the primitives inside it.
+	FSHAHash collisionHash;
+	FSixDOFOctree octree;
+
+	// Top-level cells per tile along each axis, or 0 when the bake is not tiled.
+	int32 tileSize = 0;
+	TIndirectArray<FSixDOFNavmeshTile> tiles;
+};
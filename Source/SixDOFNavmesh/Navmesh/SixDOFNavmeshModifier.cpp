@@ -10,7 +10,7 @@ ASixDOFNavmeshModifier::ASixDOFNavmeshModifier()
 	PrimaryActorTick.bCanEverTick = false;
 
 	USceneComponent* root = CreateDefaultSubobject<USceneComponent>(FName("Root"));
-	root->Mobility = EComponentMobility::Static;
+	root->Mobility = EComponentMobility::Movable;
 	RootComponent = root;
 
 	navmeshModifierBounds = CreateDefaultSubobject<UBoxComponent>(FName("Bounds"));
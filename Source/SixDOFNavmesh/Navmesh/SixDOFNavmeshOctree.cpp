@@ -0,0 +1,583 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshOctree.h"
+#include "Async/ParallelFor.h"
+
+void FOctant::Reset() {
+	SetCost(1.f);
+	navigatable = ENavigabilityStatus::Navigable;
+}
+
+void FSixDOFOctree::Init(const FVector& inOrigin, float inOctantSize, const FIntVector& inGridSize, int32 inMaxSubdivisionLevel) {
+	check(inMaxSubdivisionLevel >= SubvoxelDepth && inMaxSubdivisionLevel < 16);
+	check(SixDOFMorton::FitsGrid(inGridSize, inMaxSubdivisionLevel));
+
+	origin = inOrigin;
+	octantSize = inOctantSize;
+	gridSize = inGridSize;
+	maxLevel = inMaxSubdivisionLevel - SubvoxelDepth;
+
+	// Pools drop their chunks rather than clearing them, since published versions may still share them.
+	levels.SetNum(maxLevel + 1);
+	for (auto& level : levels) {
+		level.Reset();
+	}
+	blocks.SetNum(levels.Num());
+	for (auto& level : blocks) {
+		level.Reset();
+	}
+	links.SetNum(levels.Num());
+	for (auto& level : links) {
+		level.Reset();
+	}
+	levels[0].Reserve(gridSize.X * gridSize.Y * gridSize.Z);
+	subvoxelMasks.Reset();
+	subvoxelOwners.Reset();
+	subvoxelGenerations.Reset();
+	clearance.Reset();
+	layerMasks.Reset();
+	cellPortals.Reset();
+
+	freeBlocks.SetNum(levels.Num());
+	for (auto& level : freeBlocks) {
+		level.Reset();
+	}
+	freeMasks.Reset();
+	exhausted = false;
+}
+
+void FSixDOFOctree::Empty() {
+	levels.Empty();
+	blocks.Empty();
+	links.Empty();
+	clearance.Empty();
+	layerMasks.Empty();
+	cellPortals.Empty();
+	subvoxelMasks.Empty();
+	subvoxelOwners.Empty();
+	subvoxelGenerations.Empty();
+	freeBlocks.Empty();
+	freeMasks.Empty();
+	gridSize = FIntVector::ZeroValue;
+}
+
+void FSixDOFOctree::InitBuffer(const FSixDOFOctree& target) {
+	origin = target.origin;
+	octantSize = target.octantSize;
+	gridSize = target.gridSize;
+	maxLevel = target.maxLevel;
+	numOfLayers = target.numOfLayers;
+	levels.SetNum(target.levels.Num());
+	blocks.SetNum(target.levels.Num());
+	links.SetNum(target.levels.Num());
+	freeBlocks.SetNum(target.levels.Num());
+}
+
+void FSixDOFOctree::Extract(const FSixDOFOctree& source, TArrayView<const int32> topLevelIndices) {
+	InitBuffer(source);
+	for (int32 index : topLevelIndices) {
+		const int32 localIndex = levels[0].Add(source.levels[0][index]);
+		CopySubtree(source, FOctantHandle(0, index), FOctantHandle(0, localIndex));
+	}
+}
+
+void FSixDOFOctree::CopySubtree(const FSixDOFOctree& source, FOctantHandle sourceHandle, FOctantHandle handle) {
+	const FOctant& sourceOctant = source.Get(sourceHandle);
+	Get(handle).firstChild = INDEX_NONE;
+
+	if (sourceOctant.navigatable == ENavigabilityStatus::HasSubvoxels) {
+		if (!SetSubvoxels(handle, source.subvoxelMasks[sourceOctant.firstChild])) Get(handle).navigatable = ENavigabilityStatus::NonNavigable;
+	}
+	else if (sourceOctant.navigatable == ENavigabilityStatus::HasChildren) {
+		const int32 firstChild = AllocateChildren(handle);
+		if (firstChild == INDEX_NONE) {
+			Get(handle).navigatable = ENavigabilityStatus::NonNavigable;
+			return;
+		}
+		for (int32 i = 0; i < 8; ++i) {
+			FOctant& child = levels[handle.level + 1][firstChild + i];
+			child = source.levels[handle.level + 1][sourceOctant.firstChild + i];
+			CopySubtree(source, FOctantHandle(handle.level + 1, sourceOctant.firstChild + i), FOctantHandle(handle.level + 1, firstChild + i));
+		}
+	}
+}
+
+bool FSixDOFOctree::Append(const FSixDOFOctree& buffer, TArrayView<const int32> topLevelIndices) {
+	// Checked before anything moves, so a buffer that does not fit leaves this octree as it was.
+	for (int32 level = 1; level < levels.Num(); ++level) {
+		const int64 numOfNew = FMath::Max(buffer.levels[level].Num() - freeBlocks[level].Num() * 8, 0);
+		if (levels[level].Num() + numOfNew > FOctantHandle::MaxIndex) return false;
+	}
+	const int64 numOfNewMasks = FMath::Max(buffer.subvoxelMasks.Num() - freeMasks.Num(), 0);
+	if ((subvoxelMasks.Num() + numOfNewMasks) * SubvoxelsPerLeaf > FOctantHandle::MaxIndex) return false;
+
+	// Where each of the buffer's blocks of eight, and each of its masks, lands in this octree.
+	TArray<TArray<int32>, TInlineAllocator<16>> blockTargets;
+	blockTargets.SetNum(levels.Num());
+	auto RemapIndex = [&](int32 level, int32 index) {
+		if (index == INDEX_NONE) return INDEX_NONE;
+		return level == 0 ? topLevelIndices[index] : blockTargets[level][index / 8] + index % 8;
+	};
+
+	for (int32 level = 1; level < levels.Num(); ++level) {
+		const int32 numOfBlocks = buffer.levels[level].Num() / 8;
+		blockTargets[level].SetNumUninitialized(numOfBlocks);
+		for (int32 block = 0; block < numOfBlocks; ++block) {
+			blockTargets[level][block] = AllocateBlock(level);
+			blocks[level][blockTargets[level][block] / 8].parent = RemapIndex(level - 1, buffer.blocks[level][block].parent);
+		}
+	}
+
+	TArray<int32> maskTargets;
+	maskTargets.SetNumUninitialized(buffer.subvoxelMasks.Num());
+	for (int32 i = 0; i < buffer.subvoxelMasks.Num(); ++i) {
+		maskTargets[i] = AllocateMask();
+	}
+
+	auto Remap = [&](FOctant octant, int32 level) {
+		if (octant.firstChild != INDEX_NONE) octant.firstChild = level == maxLevel ? maskTargets[octant.firstChild] : blockTargets[level + 1][octant.firstChild / 8];
+		return octant;
+	};
+
+	// Blocks keep their own generation, so handles from before a block was released stay stale.
+	for (int32 level = 0; level < levels.Num(); ++level) {
+		for (int32 i = 0; i < buffer.levels[level].Num(); ++i) {
+			levels[level][RemapIndex(level, i)] = Remap(buffer.levels[level][i], level);
+		}
+	}
+
+	for (int32 i = 0; i < buffer.subvoxelMasks.Num(); ++i) {
+		subvoxelMasks[maskTargets[i]] = buffer.subvoxelMasks[i];
+		subvoxelOwners[maskTargets[i]] = RemapIndex(maxLevel, buffer.subvoxelOwners[i]);
+	}
+	return true;
+}
+
+void FSixDOFOctree::Serialize(FArchive& Ar) {
+	check(!Ar.IsByteSwapping());
+
+	Ar << origin;
+	Ar << octantSize;
+	Ar << gridSize;
+	Ar << maxLevel;
+
+	int32 numOfLevels = levels.Num();
+	Ar << numOfLevels;
+	if (Ar.IsLoading()) levels.SetNum(numOfLevels);
+
+	if (Ar.IsLoading()) {
+		blocks.SetNum(numOfLevels);
+		links.SetNum(numOfLevels);
+	}
+	for (int32 level = 0; level < numOfLevels; ++level) {
+		levels[level].Serialize(Ar);
+		blocks[level].Serialize(Ar);
+		links[level].Serialize(Ar);
+	}
+	subvoxelMasks.Serialize(Ar);
+	subvoxelOwners.Serialize(Ar);
+	subvoxelGenerations.Serialize(Ar);
+
+	if (Ar.IsLoading()) freeBlocks.SetNum(numOfLevels);
+	for (auto& level : freeBlocks) {
+		level.Serialize(Ar);
+	}
+	freeMasks.Serialize(Ar);
+
+	Ar << numOfLayers;
+	if (Ar.IsLoading()) clearance.SetNum(numOfLevels);
+	for (auto& level : clearance) {
+		level.Serialize(Ar);
+	}
+	layerMasks.Serialize(Ar);
+
+	cellPortals.Serialize(Ar);
+}
+
+void FSixDOFOctree::InitLayers(int32 inNumOfLayers) {
+	check(inNumOfLayers >= 1 && inNumOfLayers <= MAX_uint8);
+
+	numOfLayers = inNumOfLayers;
+	clearance.Reset();
+	layerMasks.Reset();
+	GrowLayers();
+}
+
+void FSixDOFOctree::GrowLayers() {
+	clearance.SetNum(levels.Num());
+	for (int32 level = 0; level < levels.Num(); ++level) {
+		const int32 num = clearance[level].Num();
+		clearance[level].SetNumUninitialized(levels[level].Num());
+		for (int32 i = num; i < levels[level].Num(); ++i) {
+			clearance[level][i] = MAX_uint8;
+		}
+	}
+	layerMasks.SetNumZeroed(subvoxelMasks.Num() * (numOfLayers - 1));
+}
+
+bool FSixDOFOctree::FitsLayer(FOctantHandle handle, int32 layer) const {
+	if (layer == 0) return true;
+	if (!IsSubvoxel(handle)) return clearance[handle.level][handle.index] > layer;
+
+	const int32 maskIndex = handle.index / SubvoxelsPerLeaf;
+	return !((layerMasks[maskIndex * (numOfLayers - 1) + layer - 1] >> (handle.index % SubvoxelsPerLeaf)) & 1);
+}
+
+void FSixDOFOctree::SetClearance(FOctantHandle handle, int32 numOfFittingLayers) {
+	if (!IsSubvoxel(handle)) {
+		if (AsConst(clearance[handle.level])[handle.index] != numOfFittingLayers) clearance[handle.level][handle.index] = (uint8)numOfFittingLayers;
+		return;
+	}
+
+	const int32 maskIndex = handle.index / SubvoxelsPerLeaf;
+	const uint64 bit = 1ull << (handle.index % SubvoxelsPerLeaf);
+	for (int32 layer = 1; layer < numOfLayers; ++layer) {
+		const int32 index = maskIndex * (numOfLayers - 1) + layer - 1;
+		const uint64 mask = AsConst(layerMasks)[index];
+		const uint64 newMask = layer < numOfFittingLayers ? mask & ~bit : mask | bit;
+		if (newMask != mask) layerMasks[index] = newMask;
+	}
+}
+
+void FSixDOFOctree::SetCost(FOctantHandle handle, float cost) {
+	const uint16 encoded = FFloat16(cost).Encoded;
+	if (AsConst(*this).Get(handle).cost != encoded) Get(handle).cost = encoded;
+}
+
+FOctantHandle FSixDOFOctree::GetTopLevel(int32 x, int32 y, int32 z) const {
+	if (x < 0 || y < 0 || z < 0 || x >= gridSize.X || y >= gridSize.Y || z >= gridSize.Z) return FOctantHandle();
+	return MakeHandle(0, GetTopLevelIndex(x, y, z));
+}
+
+int32 FSixDOFOctree::GetAdjacentCell(int32 index, int32 face) const {
+	FIntVector coordinate(index / (gridSize.Y * gridSize.Z), index / gridSize.Z % gridSize.Y, index % gridSize.Z);
+	coordinate[face / 2] += face & 1 ? 1 : -1;
+	if (coordinate.X < 0 || coordinate.Y < 0 || coordinate.Z < 0 || coordinate.X >= gridSize.X || coordinate.Y >= gridSize.Y || coordinate.Z >= gridSize.Z) return INDEX_NONE;
+	return GetTopLevelIndex(coordinate.X, coordinate.Y, coordinate.Z);
+}
+
+FOctantHandle FSixDOFOctree::GetPortal(int32 index, int32 face) const {
+	if (face & 1) return cellPortals[index].inner[face / 2];
+
+	const int32 adjacent = GetAdjacentCell(index, face);
+	return adjacent != INDEX_NONE ? cellPortals[adjacent].outer[face / 2] : FOctantHandle();
+}
+
+FOctantHandle FSixDOFOctree::GetChild(FOctantHandle handle, int32 childIndex) const {
+	const FOctant& octant = Get(handle);
+	if (octant.navigatable != ENavigabilityStatus::HasChildren) return FOctantHandle();
+	return MakeHandle(handle.level + 1, octant.firstChild + childIndex);
+}
+
+FOctantHandle FSixDOFOctree::GetParent(FOctantHandle handle) const {
+	if (handle.level == 0) return FOctantHandle();
+	return MakeHandle(handle.level - 1, blocks[handle.level][handle.index / 8].parent);
+}
+
+int32 FSixDOFOctree::AllocateChildren(FOctantHandle handle) {
+	check(handle.level < maxLevel);
+
+	FOctant& octant = Get(handle);
+	if (octant.firstChild != INDEX_NONE) return octant.firstChild;
+
+	const int32 firstChild = AllocateBlock(handle.level + 1);
+	if (firstChild == INDEX_NONE) return INDEX_NONE;
+
+	octant.firstChild = firstChild;
+	blocks[handle.level + 1][firstChild / 8].parent = handle.index;
+	for (int32 i = 0; i < 8; ++i) {
+		levels[handle.level + 1][firstChild + i] = FOctant();
+	}
+	return firstChild;
+}
+
+int32 FSixDOFOctree::AllocateBlock(int32 level) {
+	if (freeBlocks[level].Num() > 0) return freeBlocks[level].Pop();
+
+	// Checked in every build, since a handle past the end would alias another node.
+	if ((uint32)levels[level].Num() > FOctantHandle::MaxIndex - 8) {
+		exhausted = true;
+		return INDEX_NONE;
+	}
+
+	blocks[level].AddDefaulted();
+	return levels[level].AddDefaulted(8);
+}
+
+int32 FSixDOFOctree::AllocateMask() {
+	if (freeMasks.Num() > 0) return freeMasks.Pop();
+
+	if ((int64)(subvoxelMasks.Num() + 1) * SubvoxelsPerLeaf > FOctantHandle::MaxIndex) {
+		exhausted = true;
+		return INDEX_NONE;
+	}
+
+	subvoxelOwners.AddDefaulted();
+	subvoxelGenerations.Add(0);
+	return subvoxelMasks.AddDefaulted();
+}
+
+bool FSixDOFOctree::SetSubvoxels(FOctantHandle handle, uint64 occupancy) {
+	check(handle.level == maxLevel);
+
+	FOctant& octant = Get(handle);
+	if (octant.firstChild == INDEX_NONE) {
+		const int32 maskIndex = AllocateMask();
+		if (maskIndex == INDEX_NONE) return false;
+
+		octant.firstChild = maskIndex;
+		subvoxelOwners[maskIndex] = handle.index;
+	}
+	subvoxelMasks[octant.firstChild] = occupancy;
+	return true;
+}
+
+void FSixDOFOctree::ReleaseSubtree(FOctantHandle handle) {
+	FOctant& octant = Get(handle);
+	if (octant.firstChild == INDEX_NONE) return;
+
+	if (handle.level == maxLevel) {
+		freeMasks.Add(octant.firstChild);
+		subvoxelGenerations[octant.firstChild] = (subvoxelGenerations[octant.firstChild] + 1) & FOctantHandle::GenerationMask;
+	}
+	else {
+		// Stale blocks kept for in-place rebuilds are released too, so walk the block rather than GetChild.
+		for (int32 i = 0; i < 8; ++i) {
+			ReleaseSubtree(FOctantHandle(handle.level + 1, octant.firstChild + i));
+		}
+		FOctantBlock& block = blocks[handle.level + 1][octant.firstChild / 8];
+		block.parent = INDEX_NONE;
+		block.generation = (block.generation + 1) & FOctantHandle::GenerationMask;
+		freeBlocks[handle.level + 1].Add(octant.firstChild);
+	}
+	octant.firstChild = INDEX_NONE;
+}
+
+FOctantHandle FSixDOFOctree::GetOwner(FOctantHandle handle) const {
+	if (!IsSubvoxel(handle)) return handle;
+	return MakeHandle(maxLevel, subvoxelOwners[handle.index / SubvoxelsPerLeaf]);
+}
+
+ENavigabilityStatus FSixDOFOctree::GetStatus(FOctantHandle handle) const {
+	if (!IsSubvoxel(handle)) return Get(handle).navigatable;
+
+	uint64 mask = subvoxelMasks[handle.index / SubvoxelsPerLeaf];
+	return (mask >> (handle.index % SubvoxelsPerLeaf)) & 1 ? ENavigabilityStatus::NonNavigable : ENavigabilityStatus::Navigable;
+}
+
+FVector FSixDOFOctree::GetCenter(uint64 mortonCode, int32 level) const {
+	return origin + (FVector(SixDOFMorton::Decode(mortonCode)) + FVector(0.5f)) * (octantSize / (1 << level));
+}
+
+FVector FSixDOFOctree::GetCenter(FOctantHandle handle) const {
+	if (!IsSubvoxel(handle)) return GetCenter(Get(handle).mortonCode, handle.level);
+
+	// A sub-voxel's code is its owner's code extended by the two sub-voxel levels.
+	const FOctantHandle owner = GetOwner(handle);
+	return GetCenter((Get(owner).mortonCode << (3 * SubvoxelDepth)) | (handle.index % SubvoxelsPerLeaf), handle.level);
+}
+
+FVector FSixDOFOctree::GetExtent(FOctantHandle handle) const {
+	return GetExtent(handle.level);
+}
+
+FOctantHandle FSixDOFOctree::FindLeafAtCoordinate(const FIntVector& coordinate, int32 level) const {
+	FOctantHandle handle = GetTopLevel(coordinate.X >> level, coordinate.Y >> level, coordinate.Z >> level);
+	if (!handle.IsValid()) return handle;
+
+	while (true) {
+		const FOctant& octant = Get(handle);
+		if (octant.navigatable == ENavigabilityStatus::HasChildren && (int32)handle.level < level) {
+			const int32 shift = level - handle.level - 1;
+			const int32 childIndex = ((coordinate.X >> shift) & 1) | (((coordinate.Y >> shift) & 1) << 1) | (((coordinate.Z >> shift) & 1) << 2);
+			handle = MakeHandle(handle.level + 1, octant.firstChild + childIndex);
+		}
+		else if (octant.navigatable == ENavigabilityStatus::HasSubvoxels && level == GetSubvoxelLevel()) {
+			return GetSubvoxel(octant.firstChild, (int32)SixDOFMorton::Encode(coordinate.X & 3, coordinate.Y & 3, coordinate.Z & 3));
+		}
+		else return handle;
+	}
+}
+
+bool FSixDOFOctree::GetTopLevelRange(const FBox& box, FIntVector& outFirst, FIntVector& outLast) const {
+	const FVector min = (box.Min - origin) / octantSize;
+	const FVector max = (box.Max - origin) / octantSize;
+	outFirst = FIntVector(FMath::Max(FMath::FloorToInt(min.X), 0), FMath::Max(FMath::FloorToInt(min.Y), 0), FMath::Max(FMath::FloorToInt(min.Z), 0));
+	outLast = FIntVector(FMath::Min(FMath::FloorToInt(max.X), gridSize.X - 1), FMath::Min(FMath::FloorToInt(max.Y), gridSize.Y - 1), FMath::Min(FMath::FloorToInt(max.Z), gridSize.Z - 1));
+	return box.IsValid && outFirst.X <= outLast.X && outFirst.Y <= outLast.Y && outFirst.Z <= outLast.Z;
+}
+
+template<typename OverlapsType>
+void FSixDOFOctree::FindLeaves(const FBox& bounds, const OverlapsType& Overlaps, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels) const {
+	FIntVector first, last;
+	if (levels.Num() == 0 || !GetTopLevelRange(bounds, first, last)) return;
+
+	// Explicit stack rather than recursion, since the traversal is the same for every shape.
+	TArray<FOctantHandle, TInlineAllocator<64>> stack;
+	for (int32 x = first.X; x <= last.X; ++x) {
+		for (int32 y = first.Y; y <= last.Y; ++y) {
+			for (int32 z = first.Z; z <= last.Z; ++z) {
+				stack.Push(GetTopLevel(x, y, z));
+			}
+		}
+	}
+
+	while (stack.Num() > 0) {
+		const FOctantHandle handle = stack.Pop(false);
+		if (!Overlaps(GetCenter(handle), GetExtent(handle))) continue;
+
+		const ENavigabilityStatus status = GetStatus(handle);
+		if (status == ENavigabilityStatus::HasChildren) {
+			const int32 firstChild = Get(handle).firstChild;
+			for (int32 i = 0; i < 8; ++i) {
+				stack.Push(MakeHandle(handle.level + 1, firstChild + i));
+			}
+		}
+		else if (status == ENavigabilityStatus::HasSubvoxels && includeSubvoxels) {
+			const int32 maskIndex = Get(handle).firstChild;
+			for (int32 i = 0; i < SubvoxelsPerLeaf; ++i) {
+				stack.Push(GetSubvoxel(maskIndex, i));
+			}
+		}
+		else outLeaves.Add(handle);
+	}
+}
+
+void FSixDOFOctree::FindLeavesInBox(const FBox& box, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels) const {
+	FindLeaves(box, [&box](const FVector& center, const FVector& extent) {
+		return box.Intersect(FBox(center - extent, center + extent));
+	}, outLeaves, includeSubvoxels);
+}
+
+void FSixDOFOctree::FindLeavesInSphere(const FSphere& sphere, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels) const {
+	const float radiusSquared = sphere.W * sphere.W;
+	FindLeaves(FBox(sphere.Center - FVector(sphere.W), sphere.Center + FVector(sphere.W)), [&sphere, radiusSquared](const FVector& center, const FVector& extent) {
+		return FBox(center - extent, center + extent).ComputeSquaredDistanceToPoint(sphere.Center) <= radiusSquared;
+	}, outLeaves, includeSubvoxels);
+}
+
+void FSixDOFOctree::FindLeavesInOrientedBox(const FTransform& transform, const FVector& extent, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels) const {
+	const FVector boxCenter = transform.GetLocation();
+	const FVector boxExtent = extent * transform.GetScale3D().GetAbs();
+	const FVector axes[3] = { transform.GetUnitAxis(EAxis::X), transform.GetUnitAxis(EAxis::Y), transform.GetUnitAxis(EAxis::Z) };
+
+	// Separating axis test against the three world axes, the box's axes and their cross products.
+	auto Overlaps = [&](const FVector& center, const FVector& nodeExtent) {
+		const FVector offset = boxCenter - center;
+		auto Separates = [&](const FVector& axis) {
+			if (axis.IsNearlyZero()) return false;
+			const float radius = FMath::Abs(axis.X) * nodeExtent.X + FMath::Abs(axis.Y) * nodeExtent.Y + FMath::Abs(axis.Z) * nodeExtent.Z;
+			const float boxRadius = FMath::Abs(axis | axes[0]) * boxExtent.X + FMath::Abs(axis | axes[1]) * boxExtent.Y + FMath::Abs(axis | axes[2]) * boxExtent.Z;
+			return FMath::Abs(offset | axis) > radius + boxRadius;
+		};
+
+		for (int32 i = 0; i < 3; ++i) {
+			FVector worldAxis = FVector::ZeroVector;
+			worldAxis[i] = 1.f;
+			if (Separates(worldAxis) || Separates(axes[i])) return false;
+			for (int32 j = 0; j < 3; ++j) {
+				if (Separates(worldAxis ^ axes[j])) return false;
+			}
+		}
+		return true;
+	};
+
+	FindLeaves(FBox(-extent, extent).TransformBy(transform), Overlaps, outLeaves, includeSubvoxels);
+}
+
+FOctantHandle FSixDOFOctree::FindLeafAtLocation(const FVector& location) const {
+	const FVector local = (location - origin) / octantSize;
+	if (local.X < 0.f || local.Y < 0.f || local.Z < 0.f) return FOctantHandle();
+
+	// Top-level cells are picked by truncation. Inside a cell, a point on a face shared by two children belongs to
+	// the lower one, matching the inclusive per-child bounds test this replaced. That test then floored into the
+	// leaf's sub-voxels, so a point on a face between two sub-voxels belongs to the upper one unless it is the
+	// leaf's own face.
+	const int32 resolution = 1 << GetSubvoxelLevel();
+	auto Quantize = [resolution](double value, bool upper) {
+		const int32 cell = (int32)value;
+		const int32 offset = upper ? FMath::FloorToInt((value - cell) * resolution) : FMath::CeilToInt((value - cell) * resolution) - 1;
+		return cell * resolution + FMath::Clamp(offset, 0, resolution - 1);
+	};
+
+	const FIntVector lower(Quantize(local.X, false), Quantize(local.Y, false), Quantize(local.Z, false));
+	const FOctantHandle leaf = FindLeafAtCoordinate(lower, GetSubvoxelLevel());
+	if (!leaf.IsValid() || !IsSubvoxel(leaf)) return leaf;
+
+	const FIntVector upper(Quantize(local.X, true), Quantize(local.Y, true), Quantize(local.Z, true));
+	const FIntVector subvoxel = upper - FIntVector(lower.X & ~3, lower.Y & ~3, lower.Z & ~3);
+	return GetSubvoxel(leaf.index / SubvoxelsPerLeaf, (int32)SixDOFMorton::Encode(FMath::Min(subvoxel.X, 3), FMath::Min(subvoxel.Y, 3), FMath::Min(subvoxel.Z, 3)));
+}
+
+void FSixDOFOctree::GrowLinks() {
+	links.SetNum(levels.Num());
+	for (int32 level = 0; level < levels.Num(); ++level) {
+		links[level].SetNum(levels[level].Num());
+	}
+}
+
+void FSixDOFOctree::BuildLinks() {
+	GrowLinks();
+
+	// Each node only writes its own links, so a level can be linked in parallel once no chunk is left to copy.
+	for (int32 level = 0; level < levels.Num(); ++level) {
+		links[level].MakeUnique();
+		ParallelFor(levels[level].Num(), [this, level](int32 i) {
+			LinkNode(FOctantHandle(level, i));
+		});
+	}
+}
+
+void FSixDOFOctree::RelinkSubtree(FOctantHandle root) {
+	GrowLinks();
+
+	TArray<FOctantHandle, TInlineAllocator<64>> stack;
+	stack.Push(root);
+	while (stack.Num() > 0) {
+		FOctantHandle handle = stack.Pop(false);
+		LinkNode(handle);
+		if (Get(handle).navigatable != ENavigabilityStatus::HasChildren) continue;
+		for (int32 i = 0; i < 8; ++i) {
+			stack.Push(GetChild(handle, i));
+		}
+	}
+
+	// Larger neighbors link to an ancestor of the root, which did not change, so only same-level neighbors and
+	// their descendants along the shared face need new links back into the subtree.
+	for (int32 face = 0; face < 6; ++face) {
+		FOctantHandle neighbor = AsConst(links[root.level])[root.index].faces[face];
+		if (neighbor.IsValid() && neighbor.level == root.level) RelinkFace(neighbor, face ^ 1);
+	}
+}
+
+FOctantHandle FSixDOFOctree::FindLink(FOctantHandle handle, int32 face) const {
+	FIntVector coordinate = SixDOFMorton::Decode(Get(handle).mortonCode);
+	coordinate[face / 2] += (face & 1) ? 1 : -1;
+	return FindLeafAtCoordinate(coordinate, handle.level);
+}
+
+void FSixDOFOctree::LinkNode(FOctantHandle handle) {
+	for (int32 face = 0; face < 6; ++face) {
+		links[handle.level][handle.index].faces[face] = FindLink(handle, face);
+	}
+}
+
+void FSixDOFOctree::RelinkFace(FOctantHandle handle, int32 face) {
+	// Neighbors are outside the rebuilt subtree, so their chunks are only copied when a link really changes.
+	const FOctantHandle link = FindLink(handle, face);
+	if (AsConst(links[handle.level])[handle.index].faces[face] != link) links[handle.level][handle.index].faces[face] = link;
+	if (AsConst(*this).Get(handle).navigatable != ENavigabilityStatus::HasChildren) return;
+
+	for (int32 childIndex : FaceChildren[face ^ 1]) {
+		RelinkFace(GetChild(handle, childIndex), face);
+	}
+}
+
+int32 FSixDOFOctree::Num() const {
+	int32 num = 0;
+	for (auto& level : levels) {
+		num += level.Num();
+	}
+	return num;
+}
@@ -0,0 +1,462 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Float16.h"
+#include <type_traits>
+#include "SixDOFNavmeshOctree.generated.h"
+
+UENUM()
+enum class ENavigabilityStatus : uint8
+{
+	Navigable,
+	NonNavigable,
+	HasChildren,
+	HasSubvoxels,
+	// A top-level cell whose subtree belongs to a streamed tile that is not resident.
+	Unloaded,
+	// A top-level cell that touches geometry but has not been subdivided yet, see lazy subdivision on the volume.
+	Unrefined
+};
+
+namespace SixDOFMorton
+{
+	// Coordinates along each axis are kept to this many bits, so every cell of the finest level must lie below
+	// 1 << CoordinateBits.
+	constexpr int32 CoordinateBits = 21;
+
+	// Whether a grid's finest-level coordinates all fit in a code.
+	inline bool FitsGrid(const FIntVector& gridSize, int32 finestLevel) {
+		return ((int64)FMath::Max3(gridSize.X, gridSize.Y, gridSize.Z) << finestLevel) <= (int64)1 << CoordinateBits;
+	}
+
+	// Interleaves the low 21 bits of each coordinate as ...zyxzyx, so the low three bits of a code are its child index.
+	inline uint64 SplitBy3(uint32 value) {
+		uint64 x = value & 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffffull;
+		x = (x | x << 16) & 0x1f0000ff0000ffull;
+		x = (x | x << 8) & 0x100f00f00f00f00full;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+		x = (x | x << 2) & 0x1249249249249249ull;
+		return x;
+	}
+
+	inline uint32 CompactBy3(uint64 code) {
+		uint64 x = code & 0x1249249249249249ull;
+		x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ull;
+		x = (x ^ (x >> 4)) & 0x100f00f00f00f00full;
+		x = (x ^ (x >> 8)) & 0x1f0000ff0000ffull;
+		x = (x ^ (x >> 16)) & 0x1f00000000ffffull;
+		x = (x ^ (x >> 32)) & 0x1fffff;
+		return (uint32)x;
+	}
+
+	inline uint64 Encode(uint32 x, uint32 y, uint32 z) {
+		return SplitBy3(x) | (SplitBy3(y) << 1) | (SplitBy3(z) << 2);
+	}
+
+	inline FIntVector Decode(uint64 code) {
+		return FIntVector(CompactBy3(code), CompactBy3(code >> 1), CompactBy3(code >> 2));
+	}
+
+	// Bits of a code that belong to one axis (0 = X, 1 = Y, 2 = Z).
+	inline uint64 AxisMask(int32 axis) {
+		return 0x1249249249249249ull << axis;
+	}
+
+	// Steps a code by one along an axis without decoding it. Bits outside axisMask are left untouched.
+	inline uint64 IncrementAxis(uint64 code, uint64 axisMask) {
+		return (((code | ~axisMask) + 1) & axisMask) | (code & ~axisMask);
+	}
+
+	inline uint64 DecrementAxis(uint64 code, uint64 axisMask) {
+		return (((code & axisMask) - 1) & axisMask) | (code & ~axisMask);
+	}
+}
+
+// A 64-bit reference to a node: the pool it lives in, its index within that pool, and the generation of its slot.
+// Slots change generation whenever their block is released, so a handle kept across a rebuild can be detected as
+// stale with FSixDOFOctree::IsValid instead of silently pointing at a different node. A block's generation only
+// comes back around after 16 million releases of that same block.
+struct FOctantHandle
+{
+	static constexpr uint32 InvalidIndex = MAX_uint32;
+	// Pools are indexed with int32, so no pool may hold more nodes, or sub-voxels, than this.
+	static constexpr uint32 MaxIndex = MAX_int32;
+	static constexpr uint32 GenerationMask = (1u << 24) - 1;
+
+	uint32 index;
+	uint32 generation : 24;
+	uint32 level : 8;
+
+	FOctantHandle() : index(InvalidIndex), generation(0), level(0) {}
+	FOctantHandle(int32 level, int32 index, uint32 generation = 0) : index(index), generation(generation), level(level) {}
+
+	bool IsValid() const { return index != InvalidIndex; }
+
+	bool operator==(const FOctantHandle& other) const { return index == other.index && generation == other.generation && level == other.level; }
+	bool operator!=(const FOctantHandle& other) const { return !(*this == other); }
+
+	friend uint32 GetTypeHash(const FOctantHandle& handle) { return HashCombine(handle.index, handle.generation | (handle.level << 24)); }
+};
+
+static_assert(sizeof(FOctantHandle) == 8, "Handles are meant to stay at 8 bytes.");
+
+// 16 bytes. Everything else about a node follows from where it sits in the tree: its level from the pool it is
+// in, its geometry from its Morton code and level, its parent and generation from the side array of its block,
+// and its face links from the links side array.
+USTRUCT()
+struct FOctant
+{
+	GENERATED_USTRUCT_BODY();
+
+public:
+	FOctant() {};
+
+	// Morton code of the node's integer coordinate at its own level, measured from the volume origin.
+	uint64 mortonCode = 0;
+
+	// Index of the first of eight contiguous children in the next level's pool, or of the occupancy mask
+	// for nodes on the deepest level.
+	int32 firstChild = INDEX_NONE;
+
+	// Half-precision cost, see GetCost and SetCost.
+	uint16 cost = 0x3c00;
+
+	ENavigabilityStatus navigatable = ENavigabilityStatus::Navigable;
+
+	float GetCost() const {
+		FFloat16 half;
+		half.Encoded = cost;
+		return half.GetFloat();
+	}
+	void SetCost(float value) { cost = FFloat16(value).Encoded; }
+
+	void Reset();
+};
+
+static_assert(sizeof(FOctant) == 16, "Octree nodes are meant to stay at 16 bytes.");
+
+// Same-or-larger neighbor across each face, ordered -X, +X, -Y, +Y, -Z, +Z.
+struct FOctantLinks
+{
+	FOctantHandle faces[6];
+};
+
+// A top-level cell's place in the coarse graph that hierarchical searches plan over. Each cell owns the crossing
+// through its +X, +Y and +Z faces, so its portal on a negative face is the crossing of the cell on that side.
+struct FCellPortals
+{
+	// Pair of touching leaves, one either side of the face, that a path crosses the face through. Invalid when
+	// nothing navigable touches across the face.
+	FOctantHandle inner[3];
+	FOctantHandle outer[3];
+
+	// Cost of the cheapest path inside the cell between the portals on two faces, see GetFacePair. Negative when
+	// either face has no portal or the two are not connected inside the cell.
+	float costs[15];
+
+	// Index into costs for two different faces, in either order.
+	static int32 GetFacePair(int32 a, int32 b) {
+		if (a > b) Swap(a, b);
+		return a * (11 - a) / 2 + b - a - 1;
+	}
+};
+
+// Side entry of a block of eight nodes.
+struct FOctantBlock
+{
+	// Index of the node in the level above that owns the block, or INDEX_NONE while the block is free.
+	int32 parent = INDEX_NONE;
+	// Generation of the eight slots, bumped when the block is released. Top-level nodes are never released and
+	// stay at generation 0.
+	uint32 generation = 0;
+};
+
+// Pool of one kind of octree data, split into chunks of ChunkSize entries that copies of the pool share. Copying a
+// pool costs a pointer per chunk, and a chunk is only copied when it is written to while another copy still holds
+// it. Published versions of the octree therefore share every chunk the worker has not written to since.
+// The non-const accessors are the writes, so reads on a pool that is being written to go through a const one.
+template<typename T>
+class TSixDOFPool
+{
+public:
+	static constexpr int32 ChunkBits = 12;
+	static constexpr int32 ChunkSize = 1 << ChunkBits;
+
+	int32 Num() const { return num; }
+	bool IsValidIndex(int32 index) const { return index >= 0 && index < num; }
+
+	const T& operator[](int32 index) const { return (*chunks[index >> ChunkBits])[index & (ChunkSize - 1)]; }
+	T& operator[](int32 index) { return GetChunk(index >> ChunkBits)[index & (ChunkSize - 1)]; }
+
+	int32 Add(const T& item) {
+		const int32 index = AddDefaulted();
+		(*this)[index] = item;
+		return index;
+	}
+	// Returns the index of the first new entry.
+	int32 AddDefaulted(int32 count = 1) {
+		const int32 index = num;
+		SetNum(num + count);
+		return index;
+	}
+	T& AddDefaulted_GetRef() { return (*this)[AddDefaulted()]; }
+	T Pop() {
+		const T item = AsConst(*this)[num - 1];
+		SetNum(num - 1);
+		return item;
+	}
+
+	void SetNum(int32 newNum) { Resize(newNum, [](FChunk& chunk, int32 size) { chunk.SetNum(size); }); }
+	void SetNumUninitialized(int32 newNum) { Resize(newNum, [](FChunk& chunk, int32 size) { chunk.SetNumUninitialized(size); }); }
+	void SetNumZeroed(int32 newNum) { Resize(newNum, [](FChunk& chunk, int32 size) { chunk.SetNumZeroed(size); }); }
+	void Reserve(int32 newNum) { chunks.Reserve(FMath::DivideAndRoundUp(newNum, ChunkSize)); }
+	// Drops the chunks rather than clearing them, since other copies may still hold them.
+	void Reset() {
+		chunks.Reset();
+		num = 0;
+	}
+	void Empty() {
+		chunks.Empty();
+		num = 0;
+	}
+
+	// Copies every chunk still shared with another copy, so writers running in parallel never copy one at once.
+	void MakeUnique() {
+		for (int32 i = 0; i < chunks.Num(); ++i) {
+			GetChunk(i);
+		}
+	}
+
+	// Raw memory, laid out as one contiguous array of the entries would be.
+	void Serialize(FArchive& Ar) {
+		static_assert(std::is_trivially_copyable<T>::value, "Pools are serialized as raw memory.");
+
+		int32 newNum = num;
+		Ar << newNum;
+		if (Ar.IsLoading()) {
+			Reset();
+			SetNumUninitialized(newNum);
+		}
+		for (int32 i = 0; i < chunks.Num(); ++i) {
+			// Saving only reads, so it leaves shared chunks shared.
+			T* data = Ar.IsLoading() ? GetChunk(i).GetData() : const_cast<T*>(chunks[i]->GetData());
+			Ar.Serialize(data, (int64)chunks[i]->Num() * sizeof(T));
+		}
+	}
+
+private:
+	typedef TArray<T> FChunk;
+
+	TArray<TSharedRef<FChunk, ESPMode::ThreadSafe>> chunks;
+	int32 num = 0;
+
+	FChunk& GetChunk(int32 chunkIndex) {
+		TSharedRef<FChunk, ESPMode::ThreadSafe>& chunk = chunks[chunkIndex];
+		if (!chunk.IsUnique()) chunk = MakeShared<FChunk, ESPMode::ThreadSafe>(*chunk);
+		return *chunk;
+	}
+
+	// Only the chunks from the old or new end on are touched.
+	template<typename ResizeType>
+	void Resize(int32 newNum, const ResizeType& ResizeChunk) {
+		const int32 numOfChunks = FMath::DivideAndRoundUp(newNum, ChunkSize);
+		if (numOfChunks < chunks.Num()) chunks.RemoveAt(numOfChunks, chunks.Num() - numOfChunks);
+		for (int32 i = FMath::Min(num, newNum) >> ChunkBits; i < numOfChunks; ++i) {
+			if (i == chunks.Num()) chunks.Add(MakeShared<FChunk, ESPMode::ThreadSafe>());
+			const int32 size = FMath::Min(newNum - i * ChunkSize, ChunkSize);
+			if (chunks[i]->Num() != size) ResizeChunk(GetChunk(i), size);
+		}
+		num = newNum;
+	}
+};
+
+struct FSixDOFOctree;
+
+// Immutable published version of an octree. Whoever holds one keeps that version alive.
+typedef TSharedPtr<const FSixDOFOctree, ESPMode::ThreadSafe> FSixDOFOctreeSnapshot;
+
+// Linear octree: one pool per level. The top level is a dense grid, and every subdivided node owns a block of eight
+// children in the next pool, ordered by child index. Copies share the pools' chunks, see TSixDOFPool.
+// The two finest levels are not stored as nodes. A partially blocked node on the deepest level keeps a 4x4x4
+// occupancy mask instead, with one bit per sub-voxel in Morton order (set = blocked).
+struct FSixDOFOctree
+{
+	static constexpr int32 SubvoxelDepth = 2;
+	static constexpr int32 SubvoxelsPerLeaf = 64;
+
+	// For a neighbor across a face, the children and sub-voxels on its side that touch the face.
+	static constexpr int32 FaceChildren[6][4] = {
+		{ 1, 3, 5, 7 }, { 0, 2, 4, 6 },
+		{ 2, 3, 6, 7 }, { 0, 1, 4, 5 },
+		{ 4, 5, 6, 7 }, { 0, 1, 2, 3 }
+	};
+	static constexpr uint64 FaceSubvoxels[6] = {
+		0xaa00aa00aa00aa00ull, 0x0055005500550055ull,
+		0xcccc0000cccc0000ull, 0x0000333300003333ull,
+		0xf0f0f0f000000000ull, 0x000000000f0f0f0full
+	};
+
+	TArray<TSixDOFPool<FOctant>> levels;
+	// Parent and generation of each block of eight, per level. Empty for the top level.
+	TArray<TSixDOFPool<FOctantBlock>> blocks;
+	// Face links of every node, parallel to levels. Sized by BuildLinks and RelinkSubtree.
+	TArray<TSixDOFPool<FOctantLinks>> links;
+
+	// Agent layers. Layer 0 is a point agent, and each further layer fits a larger agent radius.
+	int32 numOfLayers = 1;
+	// How many layers fit at each node's center, parallel to levels.
+	TArray<TSixDOFPool<uint8>> clearance;
+	// For each mask, one mask per layer above 0 of the sub-voxels too close to geometry for that layer.
+	TSixDOFPool<uint64> layerMasks;
+
+	// Coarse graph over the top-level cells, parallel to levels[0] once computed. Baked with the octree, and kept up
+	// to date by the volume's worker.
+	TSixDOFPool<FCellPortals> cellPortals;
+
+	TSixDOFPool<uint64> subvoxelMasks;
+	// Index of the deepest-level node that owns each mask.
+	TSixDOFPool<int32> subvoxelOwners;
+	TSixDOFPool<uint32> subvoxelGenerations;
+
+	// Released blocks of eight per level, and released mask slots, reused before the pools grow.
+	TArray<TSixDOFPool<int32>> freeBlocks;
+	TSixDOFPool<int32> freeMasks;
+
+	FVector origin = FVector::ZeroVector;
+	float octantSize = 0.f;
+	FIntVector gridSize = FIntVector::ZeroValue;
+	int32 maxLevel = 0;
+
+	// Set when a pool ran out of handle indices, see FOctantHandle::MaxIndex. The node that could not be subdivided
+	// is left blocked, and whoever is building decides whether the result is still usable.
+	bool exhausted = false;
+
+	// inMaxSubdivisionLevel counts the sub-voxel levels, so the deepest node pool is SubvoxelDepth levels above it.
+	void Init(const FVector& inOrigin, float inOctantSize, const FIntVector& inGridSize, int32 inMaxSubdivisionLevel);
+	void Empty();
+	// Reads or writes the pools as raw blocks. Only valid between builds with the same FOctant layout.
+	void Serialize(FArchive& Ar);
+
+	// Prepares an empty octree with the same layout as target, for building a set of its top-level cells.
+	void InitBuffer(const FSixDOFOctree& target);
+	// Copies the subtrees of the given top-level cells of source into this buffer, without any free space.
+	void Extract(const FSixDOFOctree& source, TArrayView<const int32> topLevelIndices);
+	// Moves a buffer's nodes into this octree, filling free blocks first. Buffer top-level node i replaces this
+	// octree's top-level node topLevelIndices[i]. Links are not carried over, so relink afterwards. Returns false,
+	// without changing anything, when the nodes would not fit in handle indices.
+	bool Append(const FSixDOFOctree& buffer, TArrayView<const int32> topLevelIndices);
+
+	// Also rejects handles whose slot has been released since they were made.
+	bool IsValid(FOctantHandle handle) const {
+		if (!handle.IsValid()) return false;
+		if (IsSubvoxel(handle)) {
+			const int32 maskIndex = handle.index / SubvoxelsPerLeaf;
+			return subvoxelMasks.IsValidIndex(maskIndex) && subvoxelGenerations[maskIndex] == handle.generation;
+		}
+		return levels.IsValidIndex(handle.level) && levels[handle.level].IsValidIndex(handle.index) && GetGeneration(handle.level, handle.index) == handle.generation;
+	}
+
+	uint32 GetGeneration(int32 level, int32 index) const { return level > 0 ? blocks[level][index / 8].generation : 0; }
+	// Handle to a slot as it is now, carrying its current generation.
+	FOctantHandle MakeHandle(int32 level, int32 index) const { return FOctantHandle(level, index, GetGeneration(level, index)); }
+
+	FOctant& Get(FOctantHandle handle) { return levels[handle.level][handle.index]; }
+	const FOctant& Get(FOctantHandle handle) const { return levels[handle.level][handle.index]; }
+
+	int32 GetTopLevelIndex(int32 x, int32 y, int32 z) const { return (x * gridSize.Y + y) * gridSize.Z + z; }
+	FOctantHandle GetTopLevel(int32 x, int32 y, int32 z) const;
+	FOctantHandle GetChild(FOctantHandle handle, int32 childIndex) const;
+	FOctantHandle GetParent(FOctantHandle handle) const;
+
+	// Index of the top-level cell across a face, or INDEX_NONE at the edge of the grid.
+	int32 GetAdjacentCell(int32 index, int32 face) const;
+	// Index of the top-level cell a node or sub-voxel is in.
+	int32 GetCellIndex(FOctantHandle handle) const {
+		const FIntVector coordinate = GetGridCoordinate(handle);
+		return GetTopLevelIndex(coordinate.X, coordinate.Y, coordinate.Z);
+	}
+	// Leaf inside a top-level cell that paths cross its face through. Invalid when the face cannot be crossed.
+	FOctantHandle GetPortal(int32 index, int32 face) const;
+
+	// Integer coordinate of a node's top-level cell.
+	FIntVector GetGridCoordinate(FOctantHandle handle) const { return SixDOFMorton::Decode(Get(GetOwner(handle)).mortonCode >> (3 * GetOwner(handle).level)); }
+	const FOctantLinks& GetLinks(FOctantHandle handle) const { return links[handle.level][handle.index]; }
+
+	// Returns the index of the first child, reusing the node's existing block when it has one. Returns INDEX_NONE
+	// and sets exhausted when the level has no index left for a new block.
+	int32 AllocateChildren(FOctantHandle handle);
+	// Stores the occupancy of a deepest-level node, reusing its existing mask slot when it has one. Returns false
+	// and sets exhausted when there is no index left for a new mask.
+	bool SetSubvoxels(FOctantHandle handle, uint64 occupancy);
+	// Returns every block and mask below a node to the free lists and bumps their generations, in O(subtree) without
+	// touching the heap. The node's status is left to the caller.
+	void ReleaseSubtree(FOctantHandle handle);
+
+	void InitLayers(int32 inNumOfLayers);
+	// Sizes the clearance arrays to the pools. New entries fit every layer until SetClearance is called.
+	void GrowLayers();
+	bool FitsLayer(FOctantHandle handle, int32 layer) const;
+	// Only writes when the value changes, so chunks shared with published versions are left shared otherwise.
+	void SetClearance(FOctantHandle handle, int32 numOfFittingLayers);
+
+	// Sub-voxels are addressed as handles on a virtual level below the deepest pool, indexed by mask * 64 + bit.
+	int32 GetSubvoxelLevel() const { return maxLevel + SubvoxelDepth; }
+	bool IsSubvoxel(FOctantHandle handle) const { return handle.level == GetSubvoxelLevel(); }
+	FOctantHandle GetSubvoxel(int32 maskIndex, int32 bit) const { return FOctantHandle(GetSubvoxelLevel(), maskIndex * SubvoxelsPerLeaf + bit, subvoxelGenerations[maskIndex]); }
+	// The deepest-level node that owns a sub-voxel, or the handle itself for regular nodes.
+	FOctantHandle GetOwner(FOctantHandle handle) const;
+
+	// Accessors that work for both nodes and sub-voxels.
+	ENavigabilityStatus GetStatus(FOctantHandle handle) const;
+	FVector GetCenter(FOctantHandle handle) const;
+	FVector GetExtent(FOctantHandle handle) const;
+	float GetCost(FOctantHandle handle) const { return Get(GetOwner(handle)).GetCost(); }
+	// Like SetClearance, only writes when the stored half changes.
+	void SetCost(FOctantHandle handle, float cost);
+	// Geometry of a node of the given level and Morton code, whether or not it exists.
+	FVector GetCenter(uint64 mortonCode, int32 level) const;
+	FVector GetExtent(int32 level) const { return FVector(octantSize * 0.5f / (1 << level)); }
+
+	// Descends from the top-level cell by one coordinate bit per level, so a lookup costs one load per level.
+	// The coordinate is in cells of the given level, and the result is the leaf (or sub-voxel) containing it.
+	FOctantHandle FindLeafAtCoordinate(const FIntVector& coordinate, int32 level) const;
+	FOctantHandle FindLeafAtLocation(const FVector& location) const;
+
+	// Range of top-level cells touching the box, clamped to the grid. Returns false when the box misses the grid.
+	bool GetTopLevelRange(const FBox& box, FIntVector& outFirst, FIntVector& outLast) const;
+	// Region queries. Each descends only into nodes touching the shape, so every leaf is reached at most once and
+	// the cost follows the size of the result rather than the volume. Partially blocked nodes are returned whole
+	// unless includeSubvoxels is set.
+	void FindLeavesInBox(const FBox& box, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels = true) const;
+	void FindLeavesInSphere(const FSphere& sphere, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels = true) const;
+	// The box spans extent on each side of the transform's origin, scaled by the transform.
+	void FindLeavesInOrientedBox(const FTransform& transform, const FVector& extent, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels = true) const;
+
+	// Recomputes every node's face links after a full build.
+	void BuildLinks();
+	// Recomputes the links inside a rebuilt subtree and the links of same-level neighbors that point into it.
+	void RelinkSubtree(FOctantHandle root);
+
+	int32 Num() const;
+
+private:
+	// Pops a released block of the level or grows its pool by one, returning the index of its first node, or
+	// INDEX_NONE when the pool is full.
+	int32 AllocateBlock(int32 level);
+	// Pops a released mask slot or grows the masks by one, returning INDEX_NONE when they are full.
+	int32 AllocateMask();
+	void GrowLinks();
+
+	void CopySubtree(const FSixDOFOctree& source, FOctantHandle sourceHandle, FOctantHandle handle);
+
+	// Overlaps(center, extent) tests a node against the query shape, whose bounds are given to pick the top-level cells.
+	template<typename OverlapsType>
+	void FindLeaves(const FBox& bounds, const OverlapsType& Overlaps, TArray<FOctantHandle>& outLeaves, bool includeSubvoxels) const;
+
+	FOctantHandle FindLink(FOctantHandle handle, int32 face) const;
+	void LinkNode(FOctantHandle handle);
+	void RelinkFace(FOctantHandle handle, int32 face);
+};
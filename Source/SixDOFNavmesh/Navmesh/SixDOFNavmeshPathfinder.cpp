@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshPathfinder.h"
+#include "HAL/Event.h"
+
+SixDOFNavmeshPathfinder::SixDOFNavmeshPathfinder(ASixDOFNavmeshVolume* volume, int32 id) :
+	volume{ volume }, id{ id }
+{
+	wakeEvent = FPlatformProcess::GetSynchEventFromPool();
+}
+
+SixDOFNavmeshPathfinder::~SixDOFNavmeshPathfinder() {
+	if (thread) {
+		thread->Kill();
+		delete thread;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(wakeEvent);
+}
+
+void SixDOFNavmeshPathfinder::Start() {
+	thread = FRunnableThread::Create(this, *FString::Printf(TEXT("6DOF Navmesh Pathfinder %d"), id));
+}
+
+bool SixDOFNavmeshPathfinder::Init() {
+	return true;
+}
+
+uint32 SixDOFNavmeshPathfinder::Run() {
+	while (shouldRun && volume) {
+		// Searches that ran out of budget carry on straight away, after new tasks have been let in.
+		if (Tick()) continue;
+
+		searchStates.TrimIdle();
+
+		// Going idle before looking at the queues means a task queued meanwhile either is seen here or wakes us.
+		idle = true;
+		if (!CanAdmit()) wakeEvent->Wait(FTimespan::FromSeconds(tickTime));
+		idle = false;
+	}
+
+	return 0;
+}
+
+void SixDOFNavmeshPathfinder::Stop() {
+	shouldRun = false;
+	wakeEvent->Trigger();
+	if (thread) thread->WaitForCompletion();
+}
+
+void SixDOFNavmeshPathfinder::Enqueue(FPathfindingTask&& task) {
+	{
+		FScopeLock lock(&queueLock);
+		queuedTasks.Add(MoveTemp(task));
+	}
+	wakeEvent->Trigger();
+}
+
+bool SixDOFNavmeshPathfinder::WakeIfIdle() {
+	if (!idle) return false;
+	wakeEvent->Trigger();
+	return true;
+}
+
+int32 SixDOFNavmeshPathfinder::NumQueued() const {
+	FScopeLock lock(&queueLock);
+	return queuedTasks.Num();
+}
+
+bool SixDOFNavmeshPathfinder::Tick() {
+	AdmitTasks();
+
+	// Tasks take turns in list order, each expanding up to pathfindingExpansionsPerTurn octants, until the budget
+	// runs out or every task left is waiting.
+	const uint64 start = FPlatformTime::Cycles64();
+	const uint64 budget = (uint64)(volume->pathfindingBudget * 1e-6 / FPlatformTime::GetSecondsPerCycle64());
+	int32 waitingTurns = 0;
+	while (activeTasks.Num() > waitingTurns && FPlatformTime::Cycles64() - start < budget) {
+		if (nextTask >= activeTasks.Num()) nextTask = 0;
+		auto& task = activeTasks[nextTask];
+
+		if (FPlatformTime::Seconds() - task.startTime > volume->queryTimeOutLimit) {
+			task.status = EPathfindingTaskStatus::TimedOut;
+			UE_LOG(LogTemp, Warning, TEXT("Pathfinding timed out!"));
+			CompleteTask(nextTask);
+			continue;
+		}
+
+		if (task.unrefinedCells.Num() > 0) {
+			const FSixDOFOctreeSnapshot snapshot = volume->GetOctreeSnapshot();
+			const bool refined = !task.unrefinedCells.ContainsByPredicate([&snapshot](int32 index) {
+				return snapshot->levels[0][index].navigatable == ENavigabilityStatus::Unrefined;
+			});
+			if (!refined) {
+				waitingTurns++;
+				nextTask++;
+				continue;
+			}
+			volume->RestartPathfindingTask(task, snapshot);
+		}
+		waitingTurns = 0;
+
+		const uint64 turnStart = FPlatformTime::Cycles64();
+		// Searches that find they need refined cells stop there and wait.
+		for (int32 expansion = 0; expansion < volume->pathfindingExpansionsPerTurn && task.status == EPathfindingTaskStatus::InProgress && task.unrefinedCells.Num() == 0; ++expansion) {
+			volume->CalculatePath(task);
+		}
+		task.searchCycles += FPlatformTime::Cycles64() - turnStart;
+
+		if (task.status == EPathfindingTaskStatus::Failed) {
+			UE_LOG(LogTemp, Warning, TEXT("No path was found."));
+			CompleteTask(nextTask);
+			continue;
+		}
+
+		if (task.status == EPathfindingTaskStatus::Successful) {
+			// The path through unrefined cells is only a guess, so it waits for them to be subdivided.
+			if (task.unrefinedCells.Num() > 0) {
+				task.search->requestedCells.Append(task.unrefinedCells);
+				volume->SubmitSearchRequests(*task.search);
+				task.status = EPathfindingTaskStatus::InProgress;
+				nextTask++;
+				continue;
+			}
+
+			UE_LOG(LogTemp, Warning, TEXT("Path found in %f ms!"), FPlatformTime::ToMilliseconds64(task.searchCycles));
+			volume->PublishPath(task, true);
+			CompleteTask(nextTask);
+			continue;
+		}
+
+		volume->SubmitSearchRequests(*task.search);
+		nextTask++;
+	}
+
+	return activeTasks.ContainsByPredicate([](const FPathfindingTask& task) {
+		return task.unrefinedCells.Num() == 0;
+	});
+}
+
+void SixDOFNavmeshPathfinder::AdmitTasks() {
+	FPathfindingTask task;
+	while (activeTasks.Num() < volume->pathfindingTasksPerThread && (TakeQueued(task) || Steal(task))) {
+		task.search = searchStates.Acquire();
+		volume->StartPathfindingTask(task);
+		activeTasks.Add(MoveTemp(task));
+	}
+}
+
+bool SixDOFNavmeshPathfinder::TakeQueued(FPathfindingTask& outTask) {
+	FScopeLock lock(&queueLock);
+	if (queuedTasks.Num() == 0) return false;
+
+	outTask = MoveTemp(queuedTasks[0]);
+	queuedTasks.RemoveAt(0, 1, false);
+	return true;
+}
+
+bool SixDOFNavmeshPathfinder::Steal(FPathfindingTask& outTask) {
+	SixDOFNavmeshPathfinder* victim = nullptr;
+	int32 mostQueued = 0;
+	for (SixDOFNavmeshPathfinder* pathfinder : volume->pathfinders) {
+		if (pathfinder == this) continue;
+		const int32 numOfQueued = pathfinder->NumQueued();
+		if (numOfQueued > mostQueued) {
+			victim = pathfinder;
+			mostQueued = numOfQueued;
+		}
+	}
+	if (!victim) return false;
+
+	// The queue may have been emptied since it was counted.
+	FScopeLock lock(&victim->queueLock);
+	if (victim->queuedTasks.Num() == 0) return false;
+
+	outTask = victim->queuedTasks.Pop(false);
+	return true;
+}
+
+bool SixDOFNavmeshPathfinder::CanAdmit() const {
+	if (activeTasks.Num() >= volume->pathfindingTasksPerThread) return false;
+	for (SixDOFNavmeshPathfinder* pathfinder : volume->pathfinders) {
+		if (pathfinder->NumQueued() > 0) return true;
+	}
+	return false;
+}
+
+void SixDOFNavmeshPathfinder::CompleteTask(int32 index) {
+	volume->SubmitSearchRequests(*activeTasks[index].search);
+	searchStates.Release(activeTasks[index].search);
+	// Removed in order, so the task after it keeps its turn.
+	activeTasks.RemoveAt(index, 1, false);
+}
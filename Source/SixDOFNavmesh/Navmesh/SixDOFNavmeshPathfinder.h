@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include <atomic>
+#include "SixDOFNavmeshSearch.h"
+#include "SixDOFNavmeshVolume.h"
+
+// One of the threads that run path searches, all reading the published octree snapshots. New tasks wait in a
+// queue per thread until the thread has room for them. A thread that runs out of work takes the newest waiting
+// tasks from the longest queue, so a long search only holds up the few searches running beside it. Queuing a task
+// on a busy thread wakes the idle ones, so the task is stolen right away.
+class SIXDOFNAVMESH_API SixDOFNavmeshPathfinder : public FRunnable
+{
+public:
+	SixDOFNavmeshPathfinder(ASixDOFNavmeshVolume* volume, int32 id);
+	virtual ~SixDOFNavmeshPathfinder();
+
+	// Separate from construction, so every pathfinder exists before any of them looks for work to steal.
+	void Start();
+
+	bool Init() override;
+	uint32 Run() override;
+	void Stop() override;
+
+	// Safe to call from any thread.
+	void Enqueue(FPathfindingTask&& task);
+	int32 NumQueued() const;
+	// Wakes the thread if it is waiting for work, returning whether it was.
+	bool WakeIfIdle();
+	bool IsIdle() const { return idle; }
+
+private:
+	FRunnableThread* thread = nullptr;
+	FEvent* wakeEvent;
+	ASixDOFNavmeshVolume* volume;
+	int32 id;
+	bool shouldRun = true;
+	// Set while the thread waits for work.
+	std::atomic<bool> idle{ false };
+
+	float tickTime = 0.03f;
+
+	// Tasks not started yet. The owner takes them from the front, thieves from the back.
+	TArray<FPathfindingTask> queuedTasks;
+	mutable FCriticalSection queueLock;
+
+	// Owner thread only.
+	TArray<FPathfindingTask> activeTasks;
+	// The active task whose turn is next, so every slice picks up where the last one stopped.
+	int32 nextTask = 0;
+	FSixDOFSearchStatePool searchStates;
+
+	// Returns whether a search is left that could make progress right away.
+	bool Tick();
+	void AdmitTasks();
+	bool TakeQueued(FPathfindingTask& outTask);
+	bool Steal(FPathfindingTask& outTask);
+	// Whether a queued task, on this thread or another, could be admitted right now.
+	bool CanAdmit() const;
+	void CompleteTask(int32 index);
+};
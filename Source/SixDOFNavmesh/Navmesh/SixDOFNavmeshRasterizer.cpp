@@ -0,0 +1,323 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshRasterizer.h"
+#include "SixDOFNavmeshOctree.h"
+#include "EngineUtils.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+
+SixDOFNavmeshRasterizer::SixDOFNavmeshRasterizer(const FVector& origin, float cellSize, const FIntVector& gridSize) :
+	origin{ origin },
+	cellSize{ cellSize },
+	gridSize{ gridSize }
+{
+}
+
+void SixDOFNavmeshRasterizer::Gather(UWorld* world, const FCollisionObjectQueryParams& objectQueryParams, const TArray<AActor*>& ignoredActors) {
+	const FBox volumeBounds(origin, origin + FVector(gridSize) * cellSize);
+
+	for (TActorIterator<AActor> iterator(world); iterator; ++iterator) {
+		AActor* actor = *iterator;
+		if (ignoredActors.Contains(actor)) continue;
+
+		TInlineComponentArray<UPrimitiveComponent*> components(actor);
+		for (UPrimitiveComponent* component : components) {
+			if (!component->IsRegistered() || !CollisionEnabledHasQuery(component->GetCollisionEnabled())) continue;
+			if (!(objectQueryParams.GetQueryBitfield() & ECC_TO_BITFIELD(component->GetCollisionObjectType()))) continue;
+			if (!component->Bounds.GetBox().Intersect(volumeBounds)) continue;
+
+			AddComponent(component);
+		}
+	}
+
+	Build();
+}
+
+void SixDOFNavmeshRasterizer::AddComponent(UPrimitiveComponent* component) {
+	UBodySetup* bodySetup = component->GetBodySetup();
+	if (!bodySetup) return;
+	currentOwner = component->GetUniqueID();
+
+	const FTransform transform = component->GetComponentTransform();
+	const FVector scale = transform.GetScale3D().GetAbs();
+
+	// Overlap queries only see complex collision when it stands in for the simple shapes.
+	if (bodySetup->GetCollisionTraceFlag() == CTF_UseComplexAsSimple) {
+		IInterface_CollisionDataProvider* provider = Cast<IInterface_CollisionDataProvider>(bodySetup->GetOuter());
+		FTriMeshCollisionData triangleData;
+		if (!provider || !provider->ContainsPhysicsTriMeshData(true) || !provider->GetPhysicsTriMeshData(&triangleData, true)) return;
+
+		for (const FTriIndices& indices : triangleData.Indices) {
+			FTriangleShape& triangle = triangles.AddDefaulted_GetRef();
+			triangle.vertices[0] = transform.TransformPosition(FVector(triangleData.Vertices[indices.v0]));
+			triangle.vertices[1] = transform.TransformPosition(FVector(triangleData.Vertices[indices.v1]));
+			triangle.vertices[2] = transform.TransformPosition(FVector(triangleData.Vertices[indices.v2]));
+			AddShape(EShapeType::Triangle, triangles.Num() - 1, FBox(triangle.vertices, 3));
+		}
+		return;
+	}
+
+	const FKAggregateGeom& geometry = bodySetup->AggGeom;
+
+	for (const FKBoxElem& element : geometry.BoxElems) {
+		const FTransform elementTransform = element.GetTransform() * transform;
+		FOrientedBox& box = boxes.AddDefaulted_GetRef();
+		box.center = elementTransform.GetLocation();
+		box.axes[0] = elementTransform.GetUnitAxis(EAxis::X);
+		box.axes[1] = elementTransform.GetUnitAxis(EAxis::Y);
+		box.axes[2] = elementTransform.GetUnitAxis(EAxis::Z);
+		box.extent = FVector(element.X, element.Y, element.Z) * 0.5f * scale;
+
+		FVector boundsExtent = FVector::ZeroVector;
+		for (int32 i = 0; i < 3; ++i) {
+			boundsExtent += box.axes[i].GetAbs() * box.extent[i];
+		}
+		AddShape(EShapeType::Box, boxes.Num() - 1, FBox(box.center - boundsExtent, box.center + boundsExtent));
+	}
+
+	for (const FKSphereElem& element : geometry.SphereElems) {
+		FSphereShape& sphere = spheres.AddDefaulted_GetRef();
+		sphere.center = transform.TransformPosition(element.Center);
+		sphere.radius = element.Radius * scale.GetMin();
+		AddShape(EShapeType::Sphere, spheres.Num() - 1, FBox(sphere.center - FVector(sphere.radius), sphere.center + FVector(sphere.radius)));
+	}
+
+	for (const FKSphylElem& element : geometry.SphylElems) {
+		const FTransform elementTransform = element.GetTransform() * transform;
+		const FVector halfLength = elementTransform.GetUnitAxis(EAxis::Z) * element.Length * 0.5f * scale.Z;
+		FCapsuleShape& capsule = capsules.AddDefaulted_GetRef();
+		capsule.start = elementTransform.GetLocation() - halfLength;
+		capsule.end = elementTransform.GetLocation() + halfLength;
+		capsule.radius = element.Radius * FMath::Min(scale.X, scale.Y);
+
+		FBox bounds(capsule.start, capsule.start);
+		bounds += capsule.end;
+		AddShape(EShapeType::Capsule, capsules.Num() - 1, bounds.ExpandBy(capsule.radius));
+	}
+
+	for (const FKConvexElem& element : geometry.ConvexElems) {
+		const FTransform elementTransform = element.GetTransform() * transform;
+		TArray<FVector> vertices;
+		for (const FVector& vertex : element.VertexData) {
+			vertices.Add(elementTransform.TransformPosition(vertex));
+		}
+		if (vertices.Num() == 0) continue;
+
+		FConvexShape& convex = convexes.AddDefaulted_GetRef();
+		convex.bounds = FBox(vertices);
+
+		// Without an index buffer the hull is approximated by its bounds.
+		const FVector centroid = convex.bounds.GetCenter();
+		for (int32 i = 0; i + 2 < element.IndexData.Num(); i += 3) {
+			FPlane plane(vertices[element.IndexData[i]], vertices[element.IndexData[i + 1]], vertices[element.IndexData[i + 2]]);
+			if (plane.Normal().IsNearlyZero()) continue;
+			if (plane.PlaneDot(centroid) > 0.f) plane = plane.Flip();
+			convex.planes.Add(plane);
+		}
+		AddShape(EShapeType::Convex, convexes.Num() - 1, convex.bounds);
+	}
+}
+
+void SixDOFNavmeshRasterizer::AddShape(EShapeType type, int32 index, const FBox& bounds) {
+	shapes.Add({ type, index, currentOwner, bounds });
+}
+
+void SixDOFNavmeshRasterizer::Build() {
+	nodes.Reset();
+	if (shapes.Num() == 0) return;
+
+	nodes.Reserve(2 * FMath::DivideAndRoundUp(shapes.Num(), MaxShapesPerLeaf));
+	nodes.AddDefaulted();
+	BuildNode(0, 0, shapes.Num());
+}
+
+void SixDOFNavmeshRasterizer::BuildNode(int32 nodeIndex, int32 first, int32 count) {
+	FBox bounds(ForceInit);
+	FBox centers(ForceInit);
+	for (int32 i = first; i < first + count; ++i) {
+		bounds += shapes[i].bounds;
+		centers += shapes[i].bounds.GetCenter();
+	}
+	nodes[nodeIndex].bounds = bounds;
+
+	if (count <= MaxShapesPerLeaf) {
+		nodes[nodeIndex].first = first;
+		nodes[nodeIndex].count = count;
+		return;
+	}
+
+	// Median split along the axis the shape centers spread the most on.
+	const FVector size = centers.GetSize();
+	const int32 axis = size.X >= size.Y && size.X >= size.Z ? 0 : (size.Y >= size.Z ? 1 : 2);
+	TArrayView<FShapeRef>(shapes.GetData() + first, count).Sort([axis](const FShapeRef& a, const FShapeRef& b) {
+		return a.bounds.GetCenter()[axis] < b.bounds.GetCenter()[axis];
+	});
+
+	const int32 children = nodes.AddDefaulted(2);
+	nodes[nodeIndex].first = children;
+	nodes[nodeIndex].count = 0;
+	BuildNode(children, first, count / 2);
+	BuildNode(children + 1, first + count / 2, count - count / 2);
+}
+
+template<typename VisitType>
+void SixDOFNavmeshRasterizer::ForEachShape(const FBox& box, const TSet<uint32>* ignoredOwners, const VisitType& Visit) const {
+	if (nodes.Num() == 0) return;
+
+	TArray<int32, TInlineAllocator<64>> stack;
+	stack.Push(0);
+	while (stack.Num() > 0) {
+		const FNode& node = nodes[stack.Pop(false)];
+		if (!node.bounds.Intersect(box)) continue;
+
+		if (node.count == 0) {
+			stack.Push(node.first);
+			stack.Push(node.first + 1);
+			continue;
+		}
+
+		for (int32 i = node.first; i < node.first + node.count; ++i) {
+			const FShapeRef& shape = shapes[i];
+			if (!shape.bounds.Intersect(box) || (ignoredOwners && ignoredOwners->Contains(shape.owner))) continue;
+			if (!Visit(shape)) return;
+		}
+	}
+}
+
+bool SixDOFNavmeshRasterizer::Rasterize(const FVector& center, const FVector& extent, uint64& occupancy, const TSet<uint32>* ignoredOwners) const {
+	occupancy = 0;
+
+	bool overlapped = false;
+	const FVector subcellExtent = extent * 0.25f;
+	ForEachShape(FBox(center - extent, center + extent), ignoredOwners, [&](const FShapeRef& shape) {
+		if (!Intersects(shape, center, extent)) return true;
+		overlapped = true;
+
+		for (int32 i = 0; i < FSixDOFOctree::SubvoxelsPerLeaf; ++i) {
+			if (occupancy & (1ull << i)) continue;
+
+			const FVector subcellCenter = center - extent + (FVector(SixDOFMorton::Decode(i)) * 2.f + FVector(1.f)) * subcellExtent;
+			if (Intersects(shape, subcellCenter, subcellExtent)) occupancy |= 1ull << i;
+		}
+
+		return occupancy != ~0ull;
+	});
+
+	return overlapped;
+}
+
+bool SixDOFNavmeshRasterizer::Overlaps(const FVector& center, const FVector& extent, const TSet<uint32>* ignoredOwners) const {
+	bool overlapped = false;
+	ForEachShape(FBox(center - extent, center + extent), ignoredOwners, [&](const FShapeRef& shape) {
+		overlapped = Intersects(shape, center, extent);
+		return !overlapped;
+	});
+	return overlapped;
+}
+
+uint32 SixDOFNavmeshRasterizer::HashShapes(const FBox& box, const TSet<uint32>* ignoredOwners) const {
+	// Summed rather than chained, since the order of the shapes depends on how the hierarchy was built.
+	uint32 hash = 0;
+	ForEachShape(box, ignoredOwners, [&hash](const FShapeRef& shape) {
+		const FVector corners[2] = { shape.bounds.Min, shape.bounds.Max };
+		hash += FCrc::MemCrc32(corners, sizeof(corners), (uint32)shape.type) ^ shape.owner;
+		return true;
+	});
+	return hash;
+}
+
+bool SixDOFNavmeshRasterizer::Intersects(const FShapeRef& shape, const FVector& center, const FVector& extent) const {
+	switch (shape.type) {
+	case EShapeType::Box:
+		return BoxIntersects(boxes[shape.index], center, extent);
+	case EShapeType::Sphere:
+		return FBox(center - extent, center + extent).ComputeSquaredDistanceToPoint(spheres[shape.index].center) <= FMath::Square(spheres[shape.index].radius);
+	case EShapeType::Capsule:
+		return CapsuleIntersects(capsules[shape.index], center, extent);
+	case EShapeType::Convex:
+		return ConvexIntersects(convexes[shape.index], center, extent);
+	case EShapeType::Triangle:
+		return TriangleIntersects(triangles[shape.index], center, extent);
+	}
+	return false;
+}
+
+bool SixDOFNavmeshRasterizer::BoxIntersects(const FOrientedBox& box, const FVector& center, const FVector& extent) {
+	const FVector offset = box.center - center;
+
+	// The 15 candidate axes of two boxes: the three world axes, the box's axes and their cross products.
+	auto Separates = [&](const FVector& axis) {
+		if (axis.IsNearlyZero()) return false;
+		const float radius = FMath::Abs(axis.X) * extent.X + FMath::Abs(axis.Y) * extent.Y + FMath::Abs(axis.Z) * extent.Z;
+		const float boxRadius = FMath::Abs(axis | box.axes[0]) * box.extent.X + FMath::Abs(axis | box.axes[1]) * box.extent.Y + FMath::Abs(axis | box.axes[2]) * box.extent.Z;
+		return FMath::Abs(offset | axis) > radius + boxRadius;
+	};
+
+	for (int32 i = 0; i < 3; ++i) {
+		FVector worldAxis = FVector::ZeroVector;
+		worldAxis[i] = 1.f;
+		if (Separates(worldAxis) || Separates(box.axes[i])) return false;
+		for (int32 j = 0; j < 3; ++j) {
+			if (Separates(worldAxis ^ box.axes[j])) return false;
+		}
+	}
+	return true;
+}
+
+bool SixDOFNavmeshRasterizer::CapsuleIntersects(const FCapsuleShape& capsule, const FVector& center, const FVector& extent) {
+	// The distance from a point moving along the segment to the box is convex, so a ternary search finds its minimum.
+	const FBox bounds(center - extent, center + extent);
+	const float radiusSquared = FMath::Square(capsule.radius);
+	float low = 0.f;
+	float high = 1.f;
+	for (int32 i = 0; i < 24; ++i) {
+		const float a = FMath::Lerp(low, high, 1.f / 3.f);
+		const float b = FMath::Lerp(low, high, 2.f / 3.f);
+		const float distanceA = bounds.ComputeSquaredDistanceToPoint(FMath::Lerp(capsule.start, capsule.end, a));
+		if (distanceA <= radiusSquared) return true;
+		if (distanceA < bounds.ComputeSquaredDistanceToPoint(FMath::Lerp(capsule.start, capsule.end, b))) high = b;
+		else low = a;
+	}
+	return bounds.ComputeSquaredDistanceToPoint(FMath::Lerp(capsule.start, capsule.end, (low + high) * 0.5f)) <= radiusSquared;
+}
+
+bool SixDOFNavmeshRasterizer::ConvexIntersects(const FConvexShape& convex, const FVector& center, const FVector& extent) {
+	// Face planes and world axes only. Skipping the edge cross products can report a touch near the hull's edges,
+	// which errs on the side of blocking.
+	if (!convex.bounds.Intersect(FBox(center - extent, center + extent))) return false;
+
+	for (const FPlane& plane : convex.planes) {
+		const FVector normal = plane.GetNormal();
+		const float radius = FMath::Abs(normal.X) * extent.X + FMath::Abs(normal.Y) * extent.Y + FMath::Abs(normal.Z) * extent.Z;
+		if (plane.PlaneDot(center) > radius) return false;
+	}
+	return true;
+}
+
+bool SixDOFNavmeshRasterizer::TriangleIntersects(const FTriangleShape& triangle, const FVector& center, const FVector& extent) {
+	const FVector v0 = triangle.vertices[0] - center;
+	const FVector v1 = triangle.vertices[1] - center;
+	const FVector v2 = triangle.vertices[2] - center;
+
+	auto Separates = [&](const FVector& axis) {
+		const float p0 = v0 | axis;
+		const float p1 = v1 | axis;
+		const float p2 = v2 | axis;
+		const float radius = FMath::Abs(axis.X) * extent.X + FMath::Abs(axis.Y) * extent.Y + FMath::Abs(axis.Z) * extent.Z;
+		return FMath::Min3(p0, p1, p2) > radius || FMath::Max3(p0, p1, p2) < -radius;
+	};
+
+	// The box's axes, the triangle's normal, and the nine cross products of box axes and triangle edges.
+	const FVector edges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+	for (int32 i = 0; i < 3; ++i) {
+		FVector worldAxis = FVector::ZeroVector;
+		worldAxis[i] = 1.f;
+		if (Separates(worldAxis)) return false;
+		for (const FVector& edge : edges) {
+			if (Separates(worldAxis ^ edge)) return false;
+		}
+	}
+	return !Separates(edges[0] ^ edges[1]);
+}
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+
+class UPrimitiveComponent;
+
+// Voxelizes collision geometry without going through the physics scene. The collision of the primitives in the
+// volume is copied into world-space shapes once, on the game thread, and octants are then tested against those
+// shapes with separating axis tests from any thread. The shapes are kept in a bounding volume hierarchy, so a
+// query only tests the shapes near it.
+class SIXDOFNAVMESH_API SixDOFNavmeshRasterizer
+{
+public:
+	SixDOFNavmeshRasterizer(const FVector& origin, float cellSize, const FIntVector& gridSize);
+
+	// Copies the simple collision of every primitive the query params would report, or the triangles of its
+	// complex collision when it uses complex collision as simple.
+	void Gather(UWorld* world, const FCollisionObjectQueryParams& objectQueryParams, const TArray<AActor*>& ignoredActors);
+	// Copies a single primitive. Build has to run before the next query.
+	void AddComponent(UPrimitiveComponent* component);
+	void Build();
+
+	// Returns whether any shape touches the box, and fills the mask of its 4x4x4 sub-cells that a shape touches,
+	// in Morton order. Shapes copied from the primitives in ignoredOwners, by unique id, are skipped.
+	bool Rasterize(const FVector& center, const FVector& extent, uint64& occupancy, const TSet<uint32>* ignoredOwners = nullptr) const;
+	bool Overlaps(const FVector& center, const FVector& extent, const TSet<uint32>* ignoredOwners = nullptr) const;
+	// Hash of the shapes touching the box, independent of the order they were added in.
+	uint32 HashShapes(const FBox& box, const TSet<uint32>* ignoredOwners = nullptr) const;
+
+	int32 NumShapes() const { return shapes.Num(); }
+
+private:
+	enum class EShapeType : uint8
+	{
+		Box,
+		Sphere,
+		Capsule,
+		Convex,
+		Triangle
+	};
+
+	struct FShapeRef
+	{
+		EShapeType type;
+		int32 index;
+		// Unique id of the primitive the shape was copied from.
+		uint32 owner;
+		FBox bounds;
+	};
+
+	// Internal nodes have two children at first and first + 1, leaves own count shapes from first on.
+	struct FNode
+	{
+		FBox bounds;
+		int32 first;
+		int32 count;
+	};
+
+	static constexpr int32 MaxShapesPerLeaf = 4;
+
+	struct FOrientedBox
+	{
+		FVector center;
+		FVector axes[3];
+		FVector extent;
+	};
+
+	struct FSphereShape
+	{
+		FVector center;
+		float radius;
+	};
+
+	struct FCapsuleShape
+	{
+		FVector start;
+		FVector end;
+		float radius;
+	};
+
+	struct FConvexShape
+	{
+		FBox bounds;
+		// Outward facing.
+		TArray<FPlane> planes;
+	};
+
+	struct FTriangleShape
+	{
+		FVector vertices[3];
+	};
+
+	FVector origin;
+	float cellSize;
+	FIntVector gridSize;
+
+	TArray<FOrientedBox> boxes;
+	TArray<FSphereShape> spheres;
+	TArray<FCapsuleShape> capsules;
+	TArray<FConvexShape> convexes;
+	TArray<FTriangleShape> triangles;
+
+	// Reordered by Build so every leaf's shapes are contiguous.
+	TArray<FShapeRef> shapes;
+	TArray<FNode> nodes;
+	uint32 currentOwner = 0;
+
+	void AddShape(EShapeType type, int32 index, const FBox& bounds);
+	void BuildNode(int32 nodeIndex, int32 first, int32 count);
+	// Calls Visit with every shape whose bounds touch the box, until it returns false.
+	template<typename VisitType>
+	void ForEachShape(const FBox& box, const TSet<uint32>* ignoredOwners, const VisitType& Visit) const;
+	bool Intersects(const FShapeRef& shape, const FVector& center, const FVector& extent) const;
+
+	static bool BoxIntersects(const FOrientedBox& box, const FVector& center, const FVector& extent);
+	static bool CapsuleIntersects(const FCapsuleShape& capsule, const FVector& center, const FVector& extent);
+	static bool ConvexIntersects(const FConvexShape& convex, const FVector& center, const FVector& extent);
+	static bool TriangleIntersects(const FTriangleShape& triangle, const FVector& center, const FVector& extent);
+};
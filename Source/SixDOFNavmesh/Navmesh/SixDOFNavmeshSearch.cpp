@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshSearch.h"
+
+void FSixDOFSearchState::Begin() {
+	if (slots.Num() == 0) slots.SetNumZeroed(MinCapacity);
+
+	// Stamps only repeat after four billion searches, and then every slot is wiped once.
+	if (++stamp == 0) {
+		for (FSlot& slot : slots) {
+			slot.stamp = 0;
+		}
+		stamp = 1;
+	}
+	numOfEntries = 0;
+
+	// Requests stay until the volume takes them, even across searches.
+	open.Reset();
+	neighbors.Reset();
+}
+
+void FSixDOFSearchState::Trim() {
+	if (slots.Num() <= RetainedCapacity) return;
+	slots.Empty();
+	open.Empty();
+	neighbors.Empty();
+}
+
+int32 FSixDOFSearchState::FindSlot(FOctantHandle handle) const {
+	const int32 mask = slots.Num() - 1;
+	for (int32 slot = GetTypeHash(handle) & mask; ; slot = (slot + 1) & mask) {
+		if (slots[slot].stamp != stamp || slots[slot].key == handle) return slot;
+	}
+}
+
+int32 FSixDOFSearchState::FindOrAddSlot(FOctantHandle handle) {
+	int32 slot = FindSlot(handle);
+	if (slots[slot].stamp == stamp) return slot;
+
+	if ((numOfEntries + 1) * 2 > slots.Num()) {
+		Grow();
+		slot = FindSlot(handle);
+	}
+	FSlot& entry = slots[slot];
+	entry.key = handle;
+	entry.node.parent = FOctantHandle();
+	entry.node.g = TNumericLimits<float>::Max();
+	entry.node.heapIndex = INDEX_NONE;
+	entry.stamp = stamp;
+	numOfEntries++;
+	return slot;
+}
+
+void FSixDOFSearchState::Grow() {
+	TArray<FSlot> previous = MoveTemp(slots);
+	slots.SetNumZeroed(previous.Num() * 2);
+
+	// Only this search's entries move, and the open list follows them.
+	for (const FSlot& entry : previous) {
+		if (entry.stamp != stamp) continue;
+		const int32 slot = FindSlot(entry.key);
+		slots[slot] = entry;
+		if (entry.node.heapIndex != INDEX_NONE) open[entry.node.heapIndex].slot = slot;
+	}
+}
+
+FSixDOFSearchState::FNode& FSixDOFSearchState::Get(FOctantHandle handle) {
+	const int32 slot = FindSlot(handle);
+	checkSlow(slots[slot].stamp == stamp);
+	return slots[slot].node;
+}
+
+void FSixDOFSearchState::Push(FOctantHandle handle, float priority) {
+	const int32 slot = FindOrAddSlot(handle);
+	FNode& node = slots[slot].node;
+	if (node.heapIndex != INDEX_NONE) {
+		if (priority >= open[node.heapIndex].priority) return;
+		open[node.heapIndex].priority = priority;
+		SiftUp(node.heapIndex);
+		return;
+	}
+
+	node.heapIndex = open.Add({ slot, priority });
+	SiftUp(node.heapIndex);
+}
+
+void FSixDOFSearchState::Pop() {
+	if (IsEmpty()) return;
+
+	slots[open[0].slot].node.heapIndex = INDEX_NONE;
+	FOpenEntry last = open.Pop(false);
+	if (IsEmpty()) return;
+
+	Place(0, last);
+	SiftDown(0);
+}
+
+void FSixDOFSearchState::Place(int32 index, const FOpenEntry& entry) {
+	open[index] = entry;
+	slots[entry.slot].node.heapIndex = index;
+}
+
+void FSixDOFSearchState::SiftUp(int32 index) {
+	FOpenEntry entry = open[index];
+	while (index > 0) {
+		int32 parent = (index - 1) / Arity;
+		if (open[parent].priority <= entry.priority) break;
+		Place(index, open[parent]);
+		index = parent;
+	}
+	Place(index, entry);
+}
+
+void FSixDOFSearchState::SiftDown(int32 index) {
+	FOpenEntry entry = open[index];
+	while (true) {
+		int32 first = index * Arity + 1;
+		if (first >= open.Num()) break;
+
+		int32 smallest = first;
+		int32 last = FMath::Min(first + Arity, open.Num());
+		for (int32 child = first + 1; child < last; child++) {
+			if (open[child].priority < open[smallest].priority) smallest = child;
+		}
+		if (entry.priority <= open[smallest].priority) break;
+
+		Place(index, open[smallest]);
+		index = smallest;
+	}
+	Place(index, entry);
+}
+
+FSixDOFSearchState* FSixDOFSearchStatePool::Acquire() {
+	if (freeStates.Num() > 0) return freeStates.Pop(false).state;
+	return states.Add_GetRef(MakeUnique<FSixDOFSearchState>()).Get();
+}
+
+void FSixDOFSearchStatePool::Release(FSixDOFSearchState* state) {
+	if (!state) return;
+	freeStates.Add({ state, FPlatformTime::Seconds() });
+	// A thread that never runs out of work still drops the states it stopped needing.
+	TrimIdle();
+}
+
+void FSixDOFSearchStatePool::TrimIdle() {
+	const double now = FPlatformTime::Seconds();
+	for (const FFreeState& entry : freeStates) {
+		if (now - entry.releaseTime < IdleTrimSeconds) break;
+		entry.state->Trim();
+	}
+}
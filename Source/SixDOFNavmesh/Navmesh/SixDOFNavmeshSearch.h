@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SixDOFNavmeshOctree.h"
+
+// Scratch state of one A* search, in an open-addressing hash table keyed by handle. An entry only belongs to the
+// current search when its stamp matches, so starting a search costs nothing and the table is reused without
+// clearing. It grows with the number of nodes a search reaches rather than with the size of the octree.
+struct FSixDOFSearchState
+{
+	// 16 bytes.
+	struct FNode
+	{
+		FOctantHandle parent;
+		// Cost of the cheapest known path from the origin.
+		float g;
+		// Slot in the open list, or INDEX_NONE when the node is not on it.
+		int32 heapIndex;
+	};
+
+	// Starts a new search. Any graph whose nodes can be addressed by handles can be searched, so the coarse search
+	// addresses its own nodes as level 0 handles indexed by id.
+	void Begin();
+
+	// State of a node reached by this search.
+	FNode& Get(FOctantHandle handle);
+	// State of a node, starting out unreached with an infinite g when this search has not touched it yet. Adding a
+	// node may grow the table, which moves every other node's state.
+	FNode& FindOrAdd(FOctantHandle handle) { return slots[FindOrAddSlot(handle)].node; }
+
+	// Queues a node, or lowers its priority if it is already queued with a higher one.
+	void Push(FOctantHandle handle, float priority);
+	void Pop();
+	FOctantHandle Top() const { return !IsEmpty() ? slots[open[0].slot].key : FOctantHandle(); }
+	bool IsEmpty() const { return open.Num() == 0; }
+
+	// Frees the table if it has grown past RetainedCapacity, so an idle state does not keep a large search's memory.
+	void Trim();
+
+	// Reused by the search for each expansion.
+	TArray<FOctantHandle> neighbors;
+	// Top-level cells to refine and tiles to load that the search ran into, handed on to the navmesh worker.
+	TSet<int32> requestedCells;
+	TSet<FIntVector> requestedTiles;
+
+private:
+	static constexpr int32 Arity = 4;
+	// Power of two. The table doubles whenever it would become more than half full.
+	static constexpr int32 MinCapacity = 1024;
+	// About 1.8 MB.
+	static constexpr int32 RetainedCapacity = 1 << 16;
+
+	struct FSlot
+	{
+		FOctantHandle key;
+		FNode node;
+		// Slots of earlier searches count as empty. Zero is never a search's stamp.
+		uint32 stamp;
+	};
+
+	struct FOpenEntry
+	{
+		int32 slot;
+		float priority;
+	};
+
+	// Slot holding the handle, or the empty slot it would be added to.
+	int32 FindSlot(FOctantHandle handle) const;
+	int32 FindOrAddSlot(FOctantHandle handle);
+	void Grow();
+	void Place(int32 index, const FOpenEntry& entry);
+	void SiftUp(int32 index);
+	void SiftDown(int32 index);
+
+	TArray<FSlot> slots;
+	int32 numOfEntries = 0;
+	// Indexed 4-ary min-heap over slots. Node positions are kept in FNode::heapIndex.
+	TArray<FOpenEntry> open;
+	uint32 stamp = 0;
+};
+
+// Search states of one worker thread. Each search borrows one for as long as it runs, and the states are kept
+// for the next searches, so a worker stops allocating once it has as many as it runs searches at a time. The state
+// returned last is lent out first, so back-to-back long searches keep reusing the same large table, and only a
+// state left unused for IdleTrimSeconds is trimmed.
+struct FSixDOFSearchStatePool
+{
+	FSixDOFSearchState* Acquire();
+	void Release(FSixDOFSearchState* state);
+	// Trims the states that have not been lent out for IdleTrimSeconds. Cheap enough to call whenever the thread
+	// runs out of work.
+	void TrimIdle();
+
+private:
+	static constexpr double IdleTrimSeconds = 10.0;
+
+	struct FFreeState
+	{
+		FSixDOFSearchState* state;
+		double releaseTime;
+	};
+
+	TArray<TUniquePtr<FSixDOFSearchState>> states;
+	// Oldest first.
+	TArray<FFreeState> freeStates;
+};
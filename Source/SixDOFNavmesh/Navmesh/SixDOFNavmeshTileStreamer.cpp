@@ -0,0 +1,194 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshTileStreamer.h"
+#include "SixDOFNavmeshData.h"
+#include "Serialization/BulkData.h"
+#include "Serialization/MemoryReader.h"
+
+SixDOFNavmeshTileStreamer::SixDOFNavmeshTileStreamer(USixDOFNavmeshData* data, const FSixDOFOctree& octree, float streamingRadius, float memoryBudget) :
+	data{ data },
+	origin{ octree.origin },
+	octantSize{ octree.octantSize },
+	gridSize{ octree.gridSize },
+	tileSize{ data->tileSize },
+	streamingRadius{ streamingRadius },
+	memoryBudget{ (int64)(memoryBudget * 1024.f * 1024.f) }
+{
+	tileGridSize = USixDOFNavmeshData::GetTileGridSize(gridSize, tileSize);
+
+	const int32 numOfTiles = data->tiles.Num();
+	states.Init(ETileState::Unloaded, numOfTiles);
+	requests.Init(nullptr, numOfTiles);
+	requestTimes.Init(-DBL_MAX, numOfTiles);
+	requestedThisTick.Init(false, numOfTiles);
+}
+
+SixDOFNavmeshTileStreamer::~SixDOFNavmeshTileStreamer() {
+	for (IBulkDataIORequest* request : requests) {
+		if (!request) continue;
+		request->Cancel();
+		request->WaitCompletion();
+		FMemory::Free(request->GetReadResults());
+		delete request;
+	}
+
+	FTileCommand command;
+	while (commands.Dequeue(command)) {
+		FMemory::Free(command.bytes);
+	}
+}
+
+void SixDOFNavmeshTileStreamer::Tick(float deltaTime, const TArray<FVector>& sourceLocations) {
+	const double now = FPlatformTime::Seconds();
+	int32 tile;
+	bool requested = false;
+	while (requestedTiles.Dequeue(tile)) {
+		requestTimes[tile] = now;
+		requested = true;
+	}
+
+	FinishLoading();
+
+	timeSinceUpdate += deltaTime;
+	if (timeSinceUpdate < updateInterval && !requested) return;
+	timeSinceUpdate = 0.f;
+
+	UpdateWantedTiles(sourceLocations);
+}
+
+FBox SixDOFNavmeshTileStreamer::GetTileBounds(int32 tile) const {
+	const FIntVector coordinate(tile / (tileGridSize.Y * tileGridSize.Z), (tile / tileGridSize.Z) % tileGridSize.Y, tile % tileGridSize.Z);
+	const FIntVector first = coordinate * tileSize;
+	const FIntVector last(FMath::Min(first.X + tileSize, gridSize.X), FMath::Min(first.Y + tileSize, gridSize.Y), FMath::Min(first.Z + tileSize, gridSize.Z));
+	return FBox(origin + FVector(first) * octantSize, origin + FVector(last) * octantSize);
+}
+
+void SixDOFNavmeshTileStreamer::UpdateWantedTiles(const TArray<FVector>& sourceLocations) {
+	const double now = FPlatformTime::Seconds();
+
+	// Tiles in range of a source, or recently needed by a search, nearest first.
+	TArray<TPair<float, int32>> candidates;
+	for (int32 i = 0; i < states.Num(); ++i) {
+		const FBox bounds = GetTileBounds(i);
+		float distanceSquared = MAX_flt;
+		for (const FVector& location : sourceLocations) {
+			distanceSquared = FMath::Min(distanceSquared, (float)bounds.ComputeSquaredDistanceToPoint(location));
+		}
+
+		const bool inRange = distanceSquared <= streamingRadius * streamingRadius;
+		if (inRange || now - requestTimes[i] < requestLifetime) candidates.Emplace(inRange ? distanceSquared : MAX_flt, i);
+	}
+	candidates.Sort([](const TPair<float, int32>& a, const TPair<float, int32>& b) { return a.Key < b.Key; });
+
+	TBitArray<> wanted(false, states.Num());
+	int64 usedMemory = 0;
+	for (auto& candidate : candidates) {
+		const int64 size = data->tiles[candidate.Value].bulkData.GetBulkDataSize();
+		if (usedMemory + size > memoryBudget) break;
+		usedMemory += size;
+		wanted[candidate.Value] = true;
+	}
+
+	for (int32 i = 0; i < states.Num(); ++i) {
+		if (wanted[i] && states[i] == ETileState::Unloaded) StartLoading(i);
+		else if (!wanted[i] && states[i] == ETileState::Loaded) {
+			FTileCommand command;
+			command.tile = i;
+			commands.Enqueue(command);
+			states[i] = ETileState::Unloaded;
+		}
+	}
+}
+
+void SixDOFNavmeshTileStreamer::StartLoading(int32 tile) {
+	FByteBulkData& bulkData = data->tiles[tile].bulkData;
+	states[tile] = ETileState::Loading;
+
+	// Bulk data that is already in memory, as it is in the editor right after baking, cannot be streamed.
+	if (bulkData.IsBulkDataLoaded() || !bulkData.CanLoadFromDisk()) {
+		FTileCommand command;
+		command.tile = tile;
+		command.size = bulkData.GetBulkDataSize();
+		command.bytes = (uint8*)FMemory::Malloc(command.size);
+		FMemory::Memcpy(command.bytes, bulkData.LockReadOnly(), command.size);
+		bulkData.Unlock();
+
+		commands.Enqueue(command);
+		states[tile] = ETileState::Loaded;
+		return;
+	}
+
+	requests[tile] = bulkData.CreateStreamingRequest(AIOP_BelowNormal, nullptr, nullptr);
+}
+
+void SixDOFNavmeshTileStreamer::FinishLoading() {
+	for (int32 i = 0; i < requests.Num(); ++i) {
+		IBulkDataIORequest* request = requests[i];
+		if (!request || !request->PollCompletionStatus()) continue;
+
+		FTileCommand command;
+		command.tile = i;
+		command.size = request->GetSize();
+		command.bytes = request->GetReadResults();
+		delete request;
+		requests[i] = nullptr;
+
+		if (command.bytes) {
+			commands.Enqueue(command);
+			states[i] = ETileState::Loaded;
+		}
+		else {
+			UE_LOG(LogTemp, Warning, TEXT("Failed to stream navmesh tile %i."), i);
+			states[i] = ETileState::Unloaded;
+		}
+	}
+}
+
+void SixDOFNavmeshTileStreamer::RequestTile(const FIntVector& topLevelCoordinate) {
+	const int32 tile = USixDOFNavmeshData::GetTileIndex(gridSize, tileSize, topLevelCoordinate);
+	if (!requestedThisTick.IsValidIndex(tile) || requestedThisTick[tile]) return;
+
+	requestedThisTick[tile] = true;
+	requestedTiles.Enqueue(tile);
+}
+
+bool SixDOFNavmeshTileStreamer::ApplyPendingChanges(FSixDOFOctree& octree, TArray<FBox>& outChangedBounds, TArray<int32>& outLoadedCells, TArray<int32>& outEvictedCells) {
+	requestedThisTick.Init(false, requestedThisTick.Num());
+
+	bool changed = false;
+	TArray<int32> topLevelIndices;
+	FTileCommand command;
+	while (commands.Dequeue(command)) {
+		USixDOFNavmeshData::GetTopLevelIndices(gridSize, tileSize, command.tile, topLevelIndices);
+
+		// Cells rebuilt for a dynamic obstacle while the tile was away still hold subtrees of their own, which either
+		// command replaces.
+		for (int32 index : topLevelIndices) {
+			if (AsConst(octree).levels[0][index].firstChild == INDEX_NONE) continue;
+			octree.ReleaseSubtree(FOctantHandle(0, index));
+			octree.levels[0][index].navigatable = ENavigabilityStatus::Unloaded;
+		}
+
+		if (command.bytes) {
+			FSixDOFOctree buffer;
+			FMemoryReaderView reader(TArrayView<const uint8>(command.bytes, command.size));
+			buffer.Serialize(reader);
+			FMemory::Free(command.bytes);
+			if (octree.Append(buffer, topLevelIndices)) outLoadedCells.Append(topLevelIndices);
+			else UE_LOG(LogTemp, Error, TEXT("Navmesh tile %i does not fit in octree handles and stays unloaded."), command.tile);
+		}
+		else {
+			outEvictedCells.Append(topLevelIndices);
+		}
+
+		for (int32 index : topLevelIndices) {
+			octree.RelinkSubtree(FOctantHandle(0, index));
+		}
+
+		outChangedBounds.Add(GetTileBounds(command.tile));
+		changed = true;
+	}
+
+	return changed;
+}
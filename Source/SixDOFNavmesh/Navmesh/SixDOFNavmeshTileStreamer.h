@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "SixDOFNavmeshOctree.h"
+
+class USixDOFNavmeshData;
+class IBulkDataIORequest;
+
+// Keeps the tiles of a tiled bake resident around a set of streaming sources, within a memory budget.
+// Reads are issued and finished on the game thread. The octree is only touched on the navmesh worker thread,
+// which applies finished loads and evictions between pathfinding ticks.
+class SIXDOFNAVMESH_API SixDOFNavmeshTileStreamer
+{
+public:
+	SixDOFNavmeshTileStreamer(USixDOFNavmeshData* data, const FSixDOFOctree& octree, float streamingRadius, float memoryBudget);
+	~SixDOFNavmeshTileStreamer();
+
+	// Game thread.
+	void Tick(float deltaTime, const TArray<FVector>& sourceLocations);
+
+	// Worker thread. Asks for the tile holding a top-level cell, for a search that reached it while unloaded.
+	void RequestTile(const FIntVector& topLevelCoordinate);
+	// Worker thread. Applies to the working octree, so searches on published versions are unaffected. Returns
+	// whether the octree changed, the bounds of every tile that was loaded or evicted, and the top-level cells of
+	// the tiles that were loaded and of those that were evicted.
+	bool ApplyPendingChanges(FSixDOFOctree& octree, TArray<FBox>& outChangedBounds, TArray<int32>& outLoadedCells, TArray<int32>& outEvictedCells);
+
+private:
+	struct FTileCommand
+	{
+		int32 tile = INDEX_NONE;
+		// Serialized tile to append, or null to evict the tile. Freed by whoever consumes the command.
+		uint8* bytes = nullptr;
+		int64 size = 0;
+	};
+
+	enum class ETileState : uint8
+	{
+		Unloaded,
+		Loading,
+		Loaded
+	};
+
+	USixDOFNavmeshData* data;
+	FVector origin;
+	float octantSize;
+	FIntVector gridSize;
+	int32 tileSize;
+	FIntVector tileGridSize;
+
+	float streamingRadius;
+	// In bytes.
+	int64 memoryBudget;
+
+	TArray<ETileState> states;
+	TArray<IBulkDataIORequest*> requests;
+	// Time of the last search request for each tile, so tiles asked for away from any source are kept for a while.
+	TArray<double> requestTimes;
+
+	TQueue<int32> requestedTiles;
+	TQueue<FTileCommand> commands;
+	// Worker side, so a search hammering one unloaded tile only queues it once per tick.
+	TBitArray<> requestedThisTick;
+
+	float timeSinceUpdate = 0.f;
+	float updateInterval = 0.25f;
+	float requestLifetime = 5.f;
+
+	FBox GetTileBounds(int32 tile) const;
+	void UpdateWantedTiles(const TArray<FVector>& sourceLocations);
+	void StartLoading(int32 tile);
+	void FinishLoading();
+};
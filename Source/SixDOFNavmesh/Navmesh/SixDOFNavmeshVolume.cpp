@@ -2,34 +2,15 @@
 
 
 #include "SixDOFNavmeshVolume.h"
+#include "SixDOFNavmeshPathfinder.h"
 #include "DrawDebugHelpers.h"
-#include "PrioritiyQueue.h"
 #include "Algo/Reverse.h"
+#include "Algo/BinarySearch.h"
 #include "Math/UnrealMathUtility.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
-
-void FOctant::DrawDebug(UWorld* world) {
-	if (navigatable != ENavigabilityStatus::HasChildren) {
-		FColor color;
-		uint8 depth;
-		navigatable == ENavigabilityStatus::Navigable ? color = FColor::Green : color = FColor::Red;
-		navigatable == ENavigabilityStatus::Navigable ? depth = 0U : depth = 1U;
-		DrawDebugBox(world, center, extent, color, true, -1.f, depth, 2.0f);
-	}
-	else {
-		for (auto child : children) {
-			child.DrawDebug(world);
-		}
-	}
-}
-
-void FOctant::Reset() {
-	children.Empty();
-	level = 0;
-	cost = 1.f;
-	navigatable = ENavigabilityStatus::Navigable;
-}
+#include "Async/ParallelFor.h"
+#include "PhysicsEngine/BodySetup.h"
 
 ASixDOFNavmeshVolume::ASixDOFNavmeshVolume()
 {
@@ -49,10 +30,6 @@ ASixDOFNavmeshVolume::ASixDOFNavmeshVolume()
 	navmeshVolumeBounds->SetRelativeLocation(center);
 
 	octantCollisionQueryParams = FCollisionQueryParams(FName("6DOFCollisionQuery"));
-
-	for (auto channel : octantCollisionChannels) {
-		octantCollisionObjectQueryParams.AddObjectTypesToQuery(channel);
-	}
 }
 
 // Called when the game starts or when spawned
@@ -60,28 +37,358 @@ void ASixDOFNavmeshVolume::BeginPlay()
 {
 	Super::BeginPlay();
 
-	worker = new SixDOFNavmeshWorker(this);
+	InitCollisionQueryParams();
+	InitAgentLayers();
+	CollectModifiers();
 
-	octantCollisionQueryParams.AddIgnoredActors(ignoredActors);
+	if (bakedData && bakedData->IsUpToDate(ComputeCollisionHash())) {
+		LoadBakedNavmesh();
+		if (bakedData->tiles.Num() > 0) tileStreamer = new SixDOFNavmeshTileStreamer(bakedData, octree, tileStreamingRadius, tileMemoryBudget);
+	}
+	else {
+		if (bakedData) UE_LOG(LogTemp, Warning, TEXT("Baked navmesh data is out of date, rebuilding."));
+		GenerateVoxelGrid(lazySubdivision);
+	}
 
-	GenerateVoxelGrid();
+	// Regions a build has not gathered are left for the worker to ask for.
+	if (octree.levels.Num() > 0 && staticCollision.Num() == 0) {
+		const FIntVector regionGridSize = GetCollisionRegionGridSize();
+		staticCollision.SetNum(regionGridSize.X * regionGridSize.Y * regionGridSize.Z);
+	}
+
+	// Portals missing from a fresh build or a tiled bake are left to the worker. Until it is done, hierarchical
+	// searches that run into a cell without them fall back to searching the leaves.
+	if (octree.levels.Num() > 0 && octree.cellPortals.Num() != octree.levels[0].Num()) {
+		MarkPortalsDirty(FBox(octree.origin, octree.origin + FVector(octree.gridSize) * octantSize));
+	}
+	PublishOctree();
+
+	// Started once the octree exists, since the worker reads it from the first tick.
+	worker = new SixDOFNavmeshWorker(this);
+
+	const int32 numOfPathfinders = numOfPathfindingThreads > 0 ? numOfPathfindingThreads : FMath::Max(FPlatformMisc::NumberOfCores() - 1, 1);
+	for (int32 i = 0; i < numOfPathfinders; ++i) {
+		pathfinders.Add(new SixDOFNavmeshPathfinder(this, i));
+	}
+	for (SixDOFNavmeshPathfinder* pathfinder : pathfinders) {
+		pathfinder->Start();
+	}
 }
 
 void ASixDOFNavmeshVolume::EndPlay(const EEndPlayReason::Type EndPlayReason) {
 	Super::EndPlay(EndPlayReason);
 
+	// Pathfinders hand requests to the worker, so they stop first.
+	for (SixDOFNavmeshPathfinder* pathfinder : pathfinders) {
+		pathfinder->Stop();
+	}
+	for (SixDOFNavmeshPathfinder* pathfinder : pathfinders) {
+		delete pathfinder;
+	}
+	pathfinders.Reset();
+
 	worker->Stop();
 	delete worker;
+	worker = nullptr;
+
+	for (FDynamicObstacle& obstacle : dynamicObstacles) {
+		if (obstacle.component.IsValid()) obstacle.component->TransformUpdated.Remove(obstacle.transformUpdatedHandle);
+	}
+	dynamicObstacles.Reset();
+
+	// The worker has stopped and this is the game thread, so nothing else reads these any more.
+	refinementRequests.Empty();
+	tileRequests.Empty();
+	pathUpdates.Empty();
+	publishedOctree.Reset();
+	staticCollision.Empty();
+	collisionRegionRequests.Empty();
+	gatheredCollisionRegions.Empty();
+	requestedCollisionRegions.Empty();
+	dynamicCollision.Reset();
+
+	delete tileStreamer;
+	tileStreamer = nullptr;
+}
+
+void ASixDOFNavmeshVolume::InitAgentLayers() {
+	layerRadii.Reset();
+	for (float radius : agentRadii) {
+		if (radius > 0.f) layerRadii.AddUnique(radius);
+	}
+	layerRadii.Sort();
+}
+
+void ASixDOFNavmeshVolume::InitCollisionQueryParams() {
+	// Set up here rather than in the constructor, which runs before the channels are loaded.
+	octantCollisionObjectQueryParams = FCollisionObjectQueryParams();
+	for (auto channel : octantCollisionChannels) {
+		octantCollisionObjectQueryParams.AddObjectTypesToQuery(channel);
+	}
+
+	octantCollisionQueryParams.ClearIgnoredActors();
+	octantCollisionQueryParams.AddIgnoredActors(ignoredActors);
+}
+
+FIntVector ASixDOFNavmeshVolume::GetGridSize() const {
+	FVector boxScale = navmeshVolumeBounds->GetScaledBoxExtent() * 2;
+	return FIntVector(FMath::CeilToInt(boxScale.X / octantSize), FMath::CeilToInt(boxScale.Y / octantSize), FMath::CeilToInt(boxScale.Z / octantSize));
+}
+
+FSHAHash ASixDOFNavmeshVolume::ComputeCollisionHash() {
+	FSHA1 sha;
+	auto Hash = [&sha](const auto& value) { sha.Update((const uint8*)&value, sizeof(value)); };
+
+	const FIntVector gridSize = GetGridSize();
+	Hash(USixDOFNavmeshData::CurrentVersion);
+	Hash(octantSize);
+	Hash(maxSubdivisionLevel);
+	Hash(percentUntilConsideredFull);
+	Hash(gridSize);
+	Hash(streamTiles ? tileSize : 0);
+	Hash(buildBackend);
+	Hash(GetActorLocation());
+	for (auto channel : octantCollisionChannels) {
+		Hash(channel.GetValue());
+	}
+	for (float radius : layerRadii) {
+		Hash(radius);
+	}
+	// Baked costs are only valid for the modifiers they were baked with.
+	Hash(costCombineRule);
+	for (const FCostZone& zone : modifierZones) {
+		Hash(zone.transform.GetLocation());
+		Hash(zone.transform.GetRotation());
+		Hash(zone.transform.GetScale3D());
+		Hash(zone.extent);
+		Hash(zone.cost);
+	}
+
+	TArray<FOverlapResult> outOverlaps;
+	FVector extent = FVector(gridSize) * octantSize * 0.5f;
+	GetWorld()->OverlapMultiByObjectType(outOverlaps, GetActorLocation() + extent, FQuat::Identity, octantCollisionObjectQueryParams, FCollisionShape::MakeBox(extent), octantCollisionQueryParams);
+
+	// Overlap order is not stable, so primitives are hashed in path order.
+	TArray<TPair<FString, UPrimitiveComponent*>> components;
+	for (auto& overlap : outOverlaps) {
+		UPrimitiveComponent* component = overlap.GetComponent();
+		if (component) components.AddUnique(TPair<FString, UPrimitiveComponent*>(component->GetPathName(), component));
+	}
+	components.Sort([](const TPair<FString, UPrimitiveComponent*>& a, const TPair<FString, UPrimitiveComponent*>& b) { return a.Key < b.Key; });
+
+	for (auto& component : components) {
+		sha.UpdateWithString(*component.Key, component.Key.Len());
+		Hash(component.Value->GetComponentLocation());
+		Hash(component.Value->GetComponentQuat());
+		Hash(component.Value->GetComponentScale());
+		Hash(component.Value->GetCollisionObjectType());
+
+		UBodySetup* bodySetup = component.Value->GetBodySetup();
+		if (bodySetup) Hash(bodySetup->BodySetupGuid);
+	}
+
+	sha.Final();
+	FSHAHash hash;
+	sha.GetHash(hash.Hash);
+	return hash;
+}
+
+void ASixDOFNavmeshVolume::LoadBakedNavmesh() {
+	double start = FPlatformTime::Seconds();
+
+#if WITH_EDITOR
+	// The editor keeps the asset around for the next play session, so it has to stay intact.
+	octree = bakedData->octree;
+#else
+	octree = MoveTemp(bakedData->octree);
+#endif
+
+	double end = FPlatformTime::Seconds();
+	UE_LOG(LogTemp, Warning, TEXT("Loaded baked grid of %i nodes in %f seconds."), octree.Num(), end - start);
+}
+
+void ASixDOFNavmeshVolume::BakeNavmesh() {
+#if WITH_EDITOR
+	if (!bakedData) {
+		Modify();
+		bakedData = NewObject<USixDOFNavmeshData>(this, MakeUniqueObjectName(this, USixDOFNavmeshData::StaticClass(), FName("BakedNavmeshData")));
+	}
+
+	InitCollisionQueryParams();
+	InitAgentLayers();
+	CollectModifiers();
+	GenerateVoxelGrid();
+	if (octree.levels.Num() == 0) {
+		staticCollision.Empty();
+		return;
+	}
+
+	// Tiles are stored without portals, so only a whole octree has them computed here.
+	if (!streamTiles) {
+		while (portalDirtyCells.Num() > 0) {
+			TickPortalUpdates();
+		}
+	}
+
+	bakedData->Modify();
+	if (streamTiles) bakedData->StoreTiles(octree, ComputeCollisionHash(), tileSize);
+	else bakedData->Store(octree, ComputeCollisionHash());
+	bakedData->MarkPackageDirty();
+
+	octree.Empty();
+	staticCollision.Empty();
+	portalDirtyCells.Empty();
+	portalDirtyFlags.Empty();
+#endif
+}
+
+void ASixDOFNavmeshVolume::CollectModifiers() {
+	modifiers.Reset();
+	modifierZones.Reset();
+	costZones.Reset();
+
+	TArray<AActor*> navModifierActors;
+	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ASixDOFNavmeshModifier::StaticClass(), navModifierActors);
+	for (auto actor : navModifierActors) {
+		ASixDOFNavmeshModifier* navModifier = Cast<ASixDOFNavmeshModifier>(actor);
+		if (navModifier) modifiers.Add(navModifier);
+	}
+	// Sorted by path, since the hash of the baked costs depends on the order.
+	modifiers.Sort([](const ASixDOFNavmeshModifier& a, const ASixDOFNavmeshModifier& b) { return a.GetPathName() < b.GetPathName(); });
+
+	// Nothing runs on the worker yet, so its zones are filled in directly.
+	for (ASixDOFNavmeshModifier* modifier : modifiers) {
+		const FCostZone& zone = modifierZones.Add_GetRef(MakeCostZone(modifier));
+		costZones.Add(zone.id, zone);
+	}
+}
+
+ASixDOFNavmeshVolume::FCostZone ASixDOFNavmeshVolume::MakeCostZone(const ASixDOFNavmeshModifier* modifier) {
+	FCostZone zone;
+	zone.id = modifier->GetUniqueID();
+	zone.transform = modifier->navmeshModifierBounds->GetComponentTransform();
+	zone.extent = modifier->navmeshModifierBounds->GetUnscaledBoxExtent();
+	zone.cost = modifier->costModifier;
+	zone.bounds = FBox(-zone.extent, zone.extent).TransformBy(zone.transform);
+	return zone;
+}
+
+void ASixDOFNavmeshVolume::AddCostModifier(ASixDOFNavmeshModifier* modifier) {
+	if (!modifier || modifiers.Contains(modifier)) return;
+
+	modifiers.Add(modifier);
+	const FCostZone& zone = modifierZones.Add_GetRef(MakeCostZone(modifier));
+	costZoneChanges.Enqueue({ zone.id, zone });
+}
+
+void ASixDOFNavmeshVolume::RemoveCostModifier(ASixDOFNavmeshModifier* modifier) {
+	const int32 index = modifiers.Find(modifier);
+	if (index == INDEX_NONE) return;
+
+	costZoneChanges.Enqueue({ modifierZones[index].id, {} });
+	modifiers.RemoveAtSwap(index);
+	modifierZones.RemoveAtSwap(index);
+}
+
+void ASixDOFNavmeshVolume::TickCostModifiers() {
+	for (int32 i = modifiers.Num() - 1; i >= 0; --i) {
+		ASixDOFNavmeshModifier* modifier = modifiers[i];
+		if (!IsValid(modifier)) {
+			costZoneChanges.Enqueue({ modifierZones[i].id, {} });
+			modifiers.RemoveAtSwap(i);
+			modifierZones.RemoveAtSwap(i);
+			continue;
+		}
+
+		const FCostZone zone = MakeCostZone(modifier);
+		if (zone == modifierZones[i]) continue;
+
+		modifierZones[i] = zone;
+		costZoneChanges.Enqueue({ zone.id, zone });
+	}
+}
+
+void ASixDOFNavmeshVolume::TickCostUpdates() {
+	FCostZoneChange change;
+	while (costZoneChanges.Dequeue(change)) {
+		octreeChanged = true;
+		if (const FCostZone* previous = costZones.Find(change.id)) {
+			const FBox previousBounds = previous->bounds;
+			costZones.Remove(change.id);
+			UpdateCosts(previousBounds);
+		}
+		if (change.zone.IsSet()) {
+			costZones.Add(change.id, change.zone.GetValue());
+			UpdateCosts(change.zone->bounds);
+		}
+	}
+}
+
+void ASixDOFNavmeshVolume::UpdateCosts(const FBox& bounds) {
+	if (octree.levels.Num() == 0) return;
+	// Every change to the nodes ends up here, and the portal costs follow the node costs.
+	MarkPortalsDirty(bounds);
+
+	TArray<FOctantHandle> nodes;
+	octree.FindLeavesInBox(bounds, nodes, false);
+
+	// Nodes reach past bounds, so every zone touching one of them has to be looked at, not only those touching bounds.
+	FBox nodeBounds(ForceInit);
+	for (FOctantHandle node : nodes) {
+		const FVector center = octree.GetCenter(node);
+		const FVector extent = octree.GetExtent(node);
+		nodeBounds += FBox(center - extent, center + extent);
+	}
+
+	TArray<const FCostZone*, TInlineAllocator<8>> zones;
+	for (const auto& zone : costZones) {
+		if (nodeBounds.Intersect(zone.Value.bounds)) zones.Add(&zone.Value);
+	}
+
+	for (FOctantHandle node : nodes) {
+		if (octree.GetStatus(node) == ENavigabilityStatus::NonNavigable) continue;
+
+		const FVector center = octree.GetCenter(node);
+		const FVector extent = octree.GetExtent(node);
+		const FBox box(center - extent, center + extent);
+
+		float cost = 1.f;
+		for (const FCostZone* zone : zones) {
+			if (!box.Intersect(zone->bounds)) continue;
+			// The node's box in the zone's frame is a conservative fit, so rotated zones reach slightly past their corners.
+			if (!box.InverseTransformBy(zone->transform).Intersect(FBox(-zone->extent, zone->extent))) continue;
+
+			switch (costCombineRule) {
+			case ECostModifierCombine::Max: cost = FMath::Max(cost, zone->cost); break;
+			case ECostModifierCombine::Multiply: cost *= zone->cost; break;
+			case ECostModifierCombine::Add: cost += zone->cost - 1.f; break;
+			}
+		}
+
+		// Steps never cost less than their length, which keeps the straight-line heuristic in CalculatePath admissible.
+		octree.SetCost(node, FMath::Max(cost, 1.f));
+	}
+}
+
+void ASixDOFNavmeshVolume::AddStreamingSource(AActor* source) {
+	streamingSources.AddUnique(source);
+}
+
+void ASixDOFNavmeshVolume::RemoveStreamingSource(AActor* source) {
+	streamingSources.Remove(source);
 }
 
 void ASixDOFNavmeshVolume::TempFindOctant(FVector location) {
-	FOctant* octant = FindOctantAtLocation(location);
-	if (octant) {
-		octant->DrawDebug(GetWorld());
-		TArray<FOctant*> neighbors;
-		GetNeighbors(octant, neighbors);
+	const FSixDOFOctreeSnapshot snapshot = GetOctreeSnapshot();
+	if (!snapshot) return;
+
+	FOctantHandle octant = FindOctantAtLocation(*snapshot, location);
+	if (octant.IsValid()) {
+		DrawDebugOctant(*snapshot, octant);
+		TArray<FOctantHandle> neighbors;
+		GetNeighbors(*snapshot, octant, neighbors);
 		for (auto neighbor : neighbors) {
-			neighbor->DrawDebug(GetWorld());
+			DrawDebugOctant(*snapshot, neighbor);
 		}
 	}
 	else UE_LOG(LogTemp, Warning, TEXT("OCTANT NOT FOUND"));
@@ -90,408 +397,1379 @@ void ASixDOFNavmeshVolume::TempFindOctant(FVector location) {
 void ASixDOFNavmeshVolume::Tick(float DeltaTime) {
 	Super::Tick(DeltaTime);
 
+	TickCostModifiers();
+	if (pendingObstacleBounds.Num() > 0) PublishDynamicCollision();
+	TickCollisionRegionRequests();
+
+	FPathUpdate update;
+	while (pathUpdates.Dequeue(update)) {
+		if (update.actor.IsValid()) onPathUpdated.Broadcast(update.actor.Get(), update.path, update.complete);
+	}
+
+	if (tileStreamer) {
+		TArray<FVector> sourceLocations;
+		for (auto iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator) {
+			APawn* pawn = iterator->IsValid() ? (*iterator)->GetPawn() : nullptr;
+			if (pawn) sourceLocations.Add(pawn->GetActorLocation());
+		}
+		streamingSources.RemoveAll([](const TWeakObjectPtr<AActor>& source) { return !source.IsValid(); });
+		for (auto& source : streamingSources) {
+			sourceLocations.Add(source->GetActorLocation());
+		}
+
+		tileStreamer->Tick(DeltaTime, sourceLocations);
+	}
+
 	//UKismetSystemLibrary::FlushPersistentDebugLines(GetWorld());
 	//DrawDebugNavmesh();
 }
 
 void ASixDOFNavmeshVolume::TickDynamicCollisionUpdates() {
-	for (auto listener : dynamicCollisionListeners) {
-		listener->Reset();
-		SubdivideOctree(*listener);
+	updateTickStart = FPlatformTime::Seconds();
+
+	FBox bounds;
+	while (dirtyBounds.Dequeue(bounds)) {
+		MarkCellsDirty(bounds);
+	}
+	TPair<int32, FStaticCollision> gathered;
+	while (gatheredCollisionRegions.Dequeue(gathered)) {
+		staticCollision[gathered.Key] = gathered.Value;
+	}
+
+	const bool refining = backgroundRefinement && nextUnrefinedCell < unrefinedCells.Num();
+	if (dirtyCells.Num() == 0 && !refining) return;
+
+	// Taken after the bounds were dequeued, so it is at least as new as the moves that dirtied them.
+	TSharedPtr<const FDynamicCollision, ESPMode::ThreadSafe> dynamic;
+	{
+		FScopeLock lock(&dynamicCollisionLock);
+		dynamic = dynamicCollision;
 	}
+	dynamicShapes = dynamic.Get();
+
+	const double start = updateTickStart;
+	const double budget = dynamicUpdateBudget * 1e-6;
+
+	// Cells whose region has not been gathered yet stay dirty until it has.
+	TArray<int32> waitingCells;
+	int32 numOfProcessed = 0;
+	while (numOfProcessed < dirtyCells.Num()) {
+		const int32 index = dirtyCells[numOfProcessed++];
+
+		// Unloaded cells are rebuilt from their tile when it streams in.
+		FOctantHandle handle(0, index);
+		const bool loaded = octree.GetStatus(handle) != ENavigabilityStatus::Unloaded;
+		rasterizer = loaded ? FindStaticCollision(index) : nullptr;
+		if (loaded && !rasterizer) {
+			waitingCells.Add(index);
+			continue;
+		}
+		dirtyCellFlags[index] = false;
+
+		if (loaded) {
+			const uint32 hash = ComputeCellCollisionHash(handle);
+			// A cell just loaded from its tile hashes as it would without any dynamic obstacle, so it is only rebuilt
+			// where one touches it.
+			if (bakedCells.Remove(index) > 0) cellCollisionHashes.Add(index, ComputeCellCollisionHash(handle, false));
+			const uint32* previousHash = cellCollisionHashes.Find(index);
+			if (!previousHash || *previousHash != hash) {
+				cellCollisionHashes.Add(index, hash);
+				RebuildCell(index);
+			}
+		}
+
+		if (FPlatformTime::Seconds() - start >= budget) break;
+	}
+
+	dirtyCells.RemoveAt(0, numOfProcessed, false);
+	dirtyCells.Insert(waitingCells, 0);
+
+	// Cells a search or a dirty mark already refined are skipped. Refinement goes in order, so it waits for a
+	// region that has not been gathered yet.
+	while (refining && nextUnrefinedCell < unrefinedCells.Num() && FPlatformTime::Seconds() - start < budget) {
+		const int32 index = unrefinedCells[nextUnrefinedCell];
+		if (octree.GetStatus(FOctantHandle(0, index)) == ENavigabilityStatus::Unrefined) {
+			rasterizer = FindStaticCollision(index);
+			if (!rasterizer) break;
+			cellCollisionHashes.Add(index, ComputeCellCollisionHash(FOctantHandle(0, index)));
+			RebuildCell(index);
+		}
+		nextUnrefinedCell++;
+	}
+	if (refining && nextUnrefinedCell == unrefinedCells.Num()) unrefinedCells.Empty();
+
+	rasterizer = nullptr;
+	dynamicShapes = nullptr;
 }
 
-void ASixDOFNavmeshVolume::TickPathfindingUpdates(float deltaTime, int32 maxNumOfTasks) {
-	int32 numOfTasks = activePathfindingTasks.Num();
-	if (maxNumOfTasks > numOfTasks) maxNumOfTasks = numOfTasks;
+void ASixDOFNavmeshVolume::RebuildCell(int32 index) {
+	FOctantHandle handle(0, index);
+	octree.ReleaseSubtree(handle);
+	octree.levels[0][index].Reset();
+	SubdivideOctree(octree, handle);
+	octree.RelinkSubtree(handle);
+	octreeChanged = true;
+
+	if (octree.exhausted) {
+		UE_LOG(LogTemp, Error, TEXT("Ran out of octree handles rebuilding cell %i, the parts that did not fit are left blocked."), index);
+		octree.exhausted = false;
+	}
 
-	for (int32 i = 0; i < maxNumOfTasks; ++i) {
-		auto& task = activePathfindingTasks[i];
+	const FVector center = octree.GetCenter(handle);
+	const FVector extent = octree.GetExtent(handle);
+	UpdateCosts(FBox(center - extent, center + extent));
+	UpdateClearance(FBox(center - extent, center + extent).ExpandBy(layerRadii.Num() > 0 ? layerRadii.Last() : 0.f));
+}
 
-		if (task.timeTaken > queryTimeOutLimit) {
-			task.status = EPathfindingTaskStatus::TimedOut;
-			UE_LOG(LogTemp, Warning, TEXT("Pathfinding timed out!"));
-			CompletePathfindingTask(i);
-			continue;
+void ASixDOFNavmeshVolume::RequestRefinement(int32 index) {
+	if (dirtyCellFlags.Num() != octree.levels[0].Num()) dirtyCellFlags.Init(false, octree.levels[0].Num());
+	if (octree.GetStatus(FOctantHandle(0, index)) != ENavigabilityStatus::Unrefined) return;
+
+	if (dirtyCellFlags[index]) dirtyCells.RemoveSingle(index);
+	dirtyCellFlags[index] = true;
+	dirtyCells.Insert(index, 0);
+}
+
+void ASixDOFNavmeshVolume::MarkCellsDirty(const FBox& bounds) {
+	if (octree.levels.Num() == 0) return;
+	if (dirtyCellFlags.Num() != octree.levels[0].Num()) dirtyCellFlags.Init(false, octree.levels[0].Num());
+
+	FIntVector first, last;
+	if (!octree.GetTopLevelRange(bounds, first, last)) return;
+
+	for (int32 x = first.X; x <= last.X; ++x) {
+		for (int32 y = first.Y; y <= last.Y; ++y) {
+			for (int32 z = first.Z; z <= last.Z; ++z) {
+				MarkCellDirty(octree.GetTopLevelIndex(x, y, z));
+			}
+		}
+	}
+}
+
+void ASixDOFNavmeshVolume::MarkCellDirty(int32 index) {
+	if (dirtyCellFlags.Num() != octree.levels[0].Num()) dirtyCellFlags.Init(false, octree.levels[0].Num());
+	if (dirtyCellFlags[index]) return;
+	dirtyCellFlags[index] = true;
+	dirtyCells.Add(index);
+}
+
+void ASixDOFNavmeshVolume::MarkPortalsDirty(const FBox& bounds) {
+	if (octree.levels.Num() == 0) return;
+	if (portalDirtyFlags.Num() != octree.levels[0].Num()) portalDirtyFlags.Init(false, octree.levels[0].Num());
+
+	FIntVector first, last;
+	if (!octree.GetTopLevelRange(bounds, first, last)) return;
+
+	// The crossings on a cell's faces pick leaves on both sides, so the cells around it change with it.
+	for (int32 x = FMath::Max(first.X - 1, 0); x <= FMath::Min(last.X + 1, octree.gridSize.X - 1); ++x) {
+		for (int32 y = FMath::Max(first.Y - 1, 0); y <= FMath::Min(last.Y + 1, octree.gridSize.Y - 1); ++y) {
+			for (int32 z = FMath::Max(first.Z - 1, 0); z <= FMath::Min(last.Z + 1, octree.gridSize.Z - 1); ++z) {
+				const int32 index = octree.GetTopLevelIndex(x, y, z);
+				if (portalDirtyFlags[index]) continue;
+				portalDirtyFlags[index] = true;
+				portalDirtyCells.Add(index);
+			}
 		}
+	}
+}
 
-		CalculatePath(task);
+void ASixDOFNavmeshVolume::TickPortalUpdates() {
+	if (portalDirtyCells.Num() == 0) return;
+	octree.cellPortals.SetNum(octree.levels[0].Num());
+
+	// Shares the budget of this tick with the rebuilds, but always gets through one batch so portals keep up.
+	const double budget = dynamicUpdateBudget * 1e-6;
+	int32 numOfProcessed = 0;
+	TArray<int32, TInlineAllocator<PortalBatchSize>> batch;
+	TArray<FCellPortals> crossings;
+	while (numOfProcessed < portalDirtyCells.Num() && (numOfProcessed == 0 || FPlatformTime::Seconds() - updateTickStart < budget)) {
+		// Copied out, since cells are queued again below.
+		batch.Reset();
+		batch.Append(portalDirtyCells.GetData() + numOfProcessed, FMath::Min(PortalBatchSize, portalDirtyCells.Num() - numOfProcessed));
+
+		// Every crossing in the batch first, since the costs inside a cell run between the crossings on all six of its
+		// faces. They are picked in parallel into a scratch array and stored afterwards, since storing may copy a
+		// shared chunk.
+		crossings.SetNumUninitialized(batch.Num(), false);
+		ParallelFor(batch.Num(), [&](int32 i) {
+			UpdatePortalCrossings(batch[i], crossings[i]);
+		});
+		for (int32 i = 0; i < batch.Num(); ++i) {
+			FCellPortals& portals = octree.cellPortals[batch[i]];
+			bool changed = false;
+			for (int32 axis = 0; axis < 3; ++axis) {
+				changed |= portals.inner[axis] != crossings[i].inner[axis] || portals.outer[axis] != crossings[i].outer[axis];
+				portals.inner[axis] = crossings[i].inner[axis];
+				portals.outer[axis] = crossings[i].outer[axis];
+			}
+			if (!changed) continue;
+
+			// The cells on the positive sides use these crossings as their portals, so any whose costs were already
+			// worked out go back in the queue. Cells still in it, or in this batch, are flagged and left alone.
+			for (int32 axis = 0; axis < 3; ++axis) {
+				const int32 adjacent = octree.GetAdjacentCell(batch[i], axis * 2 + 1);
+				if (adjacent == INDEX_NONE || portalDirtyFlags[adjacent]) continue;
+				portalDirtyFlags[adjacent] = true;
+				portalDirtyCells.Add(adjacent);
+			}
+		}
 
-		if (task.status == EPathfindingTaskStatus::Failed) {
-			UE_LOG(LogTemp, Warning, TEXT("No path was found."));
-			CompletePathfindingTask(i);
-			continue;
+		for (int32 index : batch) {
+			UpdatePortalCosts(index);
+			portalDirtyFlags[index] = false;
 		}
+		numOfProcessed += batch.Num();
+	}
 
-		if (task.status == EPathfindingTaskStatus::Successful) {
+	portalDirtyCells.RemoveAt(0, numOfProcessed, false);
+	octreeChanged = true;
+}
 
-			UE_LOG(LogTemp, Warning, TEXT("Path found!"));
-			FOctant* prev = task.destinationOctant;
-			while (prev->id != task.originOctant->id) {
-				FOctant* next = task.closed[prev];
-				task.path.Add(next->center);
-				prev = next;
+static bool IsTraversable(ENavigabilityStatus status) {
+	return status == ENavigabilityStatus::Navigable || status == ENavigabilityStatus::Unloaded || status == ENavigabilityStatus::Unrefined;
+}
+
+void ASixDOFNavmeshVolume::UpdatePortalCrossings(int32 index, FCellPortals& portals) {
+	const FOctantHandle handle = octree.MakeHandle(0, index);
+	const FVector center = octree.GetCenter(handle);
+
+	TArray<FOctantHandle> faceLeaves;
+	TArray<FOctantHandle> neighbors;
+	for (int32 axis = 0; axis < 3; ++axis) {
+		portals.inner[axis] = FOctantHandle();
+		portals.outer[axis] = FOctantHandle();
+
+		const int32 face = axis * 2 + 1;
+		const int32 adjacent = octree.GetAdjacentCell(index, face);
+		if (adjacent == INDEX_NONE) continue;
+
+		// Of the touching pairs across the face, the one nearest its middle.
+		FVector faceCenter = center;
+		faceCenter[axis] += octantSize * 0.5f;
+		float bestDistance = TNumericLimits<float>::Max();
+
+		faceLeaves.Reset();
+		AddNeighborChildren(octree, handle, face ^ 1, faceLeaves);
+		for (FOctantHandle leaf : faceLeaves) {
+			if (!IsTraversable(octree.GetStatus(leaf))) continue;
+
+			neighbors.Reset();
+			GetNeighbors(octree, leaf, neighbors);
+			for (FOctantHandle neighbor : neighbors) {
+				if (!IsTraversable(octree.GetStatus(neighbor)) || octree.GetCellIndex(neighbor) != adjacent) continue;
+
+				const float distance = FVector::DistSquared((octree.GetCenter(leaf) + octree.GetCenter(neighbor)) * 0.5f, faceCenter);
+				if (distance >= bestDistance) continue;
+				bestDistance = distance;
+				portals.inner[axis] = leaf;
+				portals.outer[axis] = neighbor;
 			}
+		}
+	}
+}
 
-			Algo::Reverse(task.path);
-			CompletePathfindingTask(i);
-			continue;
+void ASixDOFNavmeshVolume::UpdatePortalCosts(int32 index) {
+	FCellPortals& portals = octree.cellPortals[index];
+	FOctantHandle faces[6];
+	for (int32 face = 0; face < 6; ++face) {
+		faces[face] = octree.GetPortal(index, face);
+	}
+
+	// A cell without children is crossed in a straight line, which the coarse search measures itself.
+	const ENavigabilityStatus status = octree.GetStatus(FOctantHandle(0, index));
+	const bool subdivided = status == ENavigabilityStatus::HasChildren || status == ENavigabilityStatus::HasSubvoxels;
+	for (int32 from = 0; from < 6; ++from) {
+		for (int32 to = from + 1; to < 6; ++to) {
+			portals.costs[FCellPortals::GetFacePair(from, to)] = faces[from].IsValid() && faces[to].IsValid() && !subdivided ? 0.f : -1.f;
+		}
+	}
+	if (!subdivided) return;
+
+	// Dijkstra from each portal, kept inside the cell, until the portals after it are all settled.
+	for (int32 from = 0; from < 5; ++from) {
+		if (!faces[from].IsValid()) continue;
+
+		int32 numOfRemaining = 0;
+		for (int32 to = from + 1; to < 6; ++to) {
+			if (faces[to].IsValid()) numOfRemaining++;
+		}
+		if (numOfRemaining == 0) continue;
+
+		portalSearch.Begin();
+		portalSearch.FindOrAdd(faces[from]).g = 0.f;
+		portalSearch.Push(faces[from], 0.f);
+		while (!portalSearch.IsEmpty() && numOfRemaining > 0) {
+			const FOctantHandle curr = portalSearch.Top();
+			portalSearch.Pop();
+			for (int32 to = from + 1; to < 6; ++to) {
+				if (faces[to] == curr) numOfRemaining--;
+			}
+
+			portalSearch.neighbors.Reset();
+			GetNeighbors(octree, curr, portalSearch.neighbors);
+
+			const float currG = portalSearch.Get(curr).g;
+			const FVector currCenter = octree.GetCenter(curr);
+			for (FOctantHandle neighbor : portalSearch.neighbors) {
+				if (octree.GetStatus(neighbor) != ENavigabilityStatus::Navigable || octree.GetCellIndex(neighbor) != index) continue;
+
+				const float g = currG + FVector::Dist(currCenter, octree.GetCenter(neighbor)) * octree.GetCost(neighbor);
+				FSixDOFSearchState::FNode& node = portalSearch.FindOrAdd(neighbor);
+				if (node.g <= g) continue;
+				node.parent = curr;
+				node.g = g;
+				portalSearch.Push(neighbor, g);
+			}
+		}
+
+		for (int32 to = from + 1; to < 6; ++to) {
+			if (!faces[to].IsValid()) continue;
+			const float g = portalSearch.FindOrAdd(faces[to]).g;
+			portals.costs[FCellPortals::GetFacePair(from, to)] = g < TNumericLimits<float>::Max() ? g : -1.f;
 		}
+	}
+}
 
-		task.timeTaken += deltaTime;
+uint32 ASixDOFNavmeshVolume::ComputeCellCollisionHash(FOctantHandle handle, bool withDynamicShapes) {
+	const FVector center = octree.GetCenter(handle);
+	const FVector extent = octree.GetExtent(handle);
+	const FBox box(center - extent, center + extent);
+
+	const uint32 hash = rasterizer->HashShapes(box, dynamicShapes ? &dynamicShapes->owners : nullptr);
+	// No shapes hash to 0, so leaving them out is the same as none of them touching the cell.
+	return HashCombine(hash, dynamicShapes && withDynamicShapes ? dynamicShapes->shapes.HashShapes(box) : 0);
+}
+
+void ASixDOFNavmeshVolume::SeedCellCollisionHashes() {
+	// Obstacles standing in the volume were built in with the static shapes, so the cells they touch hash
+	// differently on their first mark and are rebuilt, while the rest are skipped.
+	TArray<uint32> hashes;
+	hashes.SetNumUninitialized(octree.levels[0].Num());
+	ParallelFor(hashes.Num(), [&](int32 i) {
+		hashes[i] = ComputeCellCollisionHash(FOctantHandle(0, i));
+	});
+
+	cellCollisionHashes.Empty(hashes.Num());
+	for (int32 i = 0; i < hashes.Num(); ++i) {
+		if (octree.GetStatus(FOctantHandle(0, i)) != ENavigabilityStatus::Unrefined) cellCollisionHashes.Add(i, hashes[i]);
 	}
 }
 
+void ASixDOFNavmeshVolume::OnObstacleTransformUpdated(USceneComponent* component, EUpdateTransformFlags flags, ETeleportType teleport) {
+	FDynamicObstacle* obstacle = dynamicObstacles.FindByPredicate([component](const FDynamicObstacle& obstacle) { return obstacle.component == component; });
+	if (!obstacle) return;
+
+	// Measured from the bounds last marked, so slow movement still adds up to a rebuild.
+	const FBox bounds = obstacle->component->Bounds.GetBox();
+	const FVector offset = FVector::Max((bounds.Min - obstacle->bounds.Min).GetAbs(), (bounds.Max - obstacle->bounds.Max).GetAbs());
+	if (offset.GetMax() <= obstacleMoveThreshold) return;
 
-void ASixDOFNavmeshVolume::CompletePathfindingTask(int32 index) {
-	activePathfindingTasks.RemoveAtSwap(index);
+	// One mark for the old and new bounds together, as the obstacle mostly overlaps where it was.
+	pendingObstacleBounds.Add(obstacle->bounds + bounds);
+	obstacle->bounds = bounds;
+}
+
+void ASixDOFNavmeshVolume::AddDynamicObstacle(UPrimitiveComponent* component) {
+	if (!component || dynamicObstacles.ContainsByPredicate([component](const FDynamicObstacle& obstacle) { return obstacle.component == component; })) return;
+
+	FDynamicObstacle& obstacle = dynamicObstacles.AddDefaulted_GetRef();
+	obstacle.component = component;
+	obstacle.bounds = component->Bounds.GetBox();
+	obstacle.transformUpdatedHandle = component->TransformUpdated.AddUObject(this, &ASixDOFNavmeshVolume::OnObstacleTransformUpdated);
+
+	// Obstacles spawned after the build are not in the octree yet. Cells whose hash the build recorded are skipped
+	// where they already match.
+	pendingObstacleBounds.Add(obstacle.bounds);
+}
+
+void ASixDOFNavmeshVolume::RemoveDynamicObstacle(UPrimitiveComponent* component) {
+	const int32 index = dynamicObstacles.IndexOfByPredicate([component](const FDynamicObstacle& obstacle) { return obstacle.component == component; });
+	if (index == INDEX_NONE) return;
+
+	FDynamicObstacle& obstacle = dynamicObstacles[index];
+	if (obstacle.component.IsValid()) obstacle.component->TransformUpdated.Remove(obstacle.transformUpdatedHandle);
+	pendingObstacleBounds.Add(obstacle.bounds);
+	dynamicObstacles.RemoveAtSwap(index);
+}
+
+void ASixDOFNavmeshVolume::MarkDirty(FBox bounds) {
+	dirtyBounds.Enqueue(bounds);
+}
+
+void ASixDOFNavmeshVolume::GatherStaticCollision() {
+	TSharedRef<SixDOFNavmeshRasterizer, ESPMode::ThreadSafe> shapes = MakeShared<SixDOFNavmeshRasterizer, ESPMode::ThreadSafe>(GetActorLocation(), octantSize, GetGridSize());
+	shapes->Gather(GetWorld(), octantCollisionObjectQueryParams, ignoredActors);
+
+	const FIntVector regionGridSize = GetCollisionRegionGridSize();
+	staticCollision.Init(shapes, regionGridSize.X * regionGridSize.Y * regionGridSize.Z);
+}
+
+void ASixDOFNavmeshVolume::TickCollisionRegionRequests() {
+	const FIntVector regionGridSize = GetCollisionRegionGridSize();
+	bool gathered = false;
+	int32 region;
+	while (collisionRegionRequests.Dequeue(region)) {
+		// The octree's placement never changes during play, so it is safe to read here.
+		const FIntVector coordinate(region / (regionGridSize.Y * regionGridSize.Z), (region / regionGridSize.Z) % regionGridSize.Y, region % regionGridSize.Z);
+		const FIntVector first = coordinate * collisionRegionSize;
+		const FIntVector size(FMath::Min(collisionRegionSize, octree.gridSize.X - first.X), FMath::Min(collisionRegionSize, octree.gridSize.Y - first.Y), FMath::Min(collisionRegionSize, octree.gridSize.Z - first.Z));
+
+		TSharedRef<SixDOFNavmeshRasterizer, ESPMode::ThreadSafe> shapes = MakeShared<SixDOFNavmeshRasterizer, ESPMode::ThreadSafe>(octree.origin + FVector(first) * octantSize, octantSize, size);
+		shapes->Gather(GetWorld(), octantCollisionObjectQueryParams, ignoredActors);
+		gatheredCollisionRegions.Enqueue(TPair<int32, FStaticCollision>(region, shapes));
+		gathered = true;
+	}
+
+	if (gathered && worker) worker->Wake();
+}
+
+FIntVector ASixDOFNavmeshVolume::GetCollisionRegionGridSize() const {
+	const FIntVector gridSize = octree.levels.Num() > 0 ? octree.gridSize : GetGridSize();
+	return FIntVector(FMath::DivideAndRoundUp(gridSize.X, collisionRegionSize), FMath::DivideAndRoundUp(gridSize.Y, collisionRegionSize), FMath::DivideAndRoundUp(gridSize.Z, collisionRegionSize));
+}
+
+int32 ASixDOFNavmeshVolume::GetCollisionRegion(int32 cellIndex) const {
+	const FIntVector regionGridSize = GetCollisionRegionGridSize();
+	const FIntVector coordinate(cellIndex / (octree.gridSize.Y * octree.gridSize.Z), (cellIndex / octree.gridSize.Z) % octree.gridSize.Y, cellIndex % octree.gridSize.Z);
+	return ((coordinate.X / collisionRegionSize) * regionGridSize.Y + coordinate.Y / collisionRegionSize) * regionGridSize.Z + coordinate.Z / collisionRegionSize;
+}
+
+const SixDOFNavmeshRasterizer* ASixDOFNavmeshVolume::FindStaticCollision(int32 cellIndex) {
+	const int32 region = GetCollisionRegion(cellIndex);
+	if (staticCollision[region]) return staticCollision[region].Get();
+
+	if (requestedCollisionRegions.Num() != staticCollision.Num()) requestedCollisionRegions.Init(false, staticCollision.Num());
+	if (!requestedCollisionRegions[region]) {
+		requestedCollisionRegions[region] = true;
+		collisionRegionRequests.Enqueue(region);
+	}
+	return nullptr;
+}
+
+void ASixDOFNavmeshVolume::PublishDynamicCollision() {
+	TSharedRef<FDynamicCollision, ESPMode::ThreadSafe> collision = MakeShared<FDynamicCollision, ESPMode::ThreadSafe>(GetActorLocation(), octantSize, GetGridSize());
+	for (const FDynamicObstacle& obstacle : dynamicObstacles) {
+		if (!obstacle.component.IsValid()) continue;
+		collision->shapes.AddComponent(obstacle.component.Get());
+		collision->owners.Add(obstacle.component->GetUniqueID());
+	}
+	collision->shapes.Build();
+
+	{
+		FScopeLock lock(&dynamicCollisionLock);
+		dynamicCollision = collision;
+	}
+
+	for (const FBox& bounds : pendingObstacleBounds) {
+		MarkDirty(bounds);
+	}
+	pendingObstacleBounds.Reset();
+}
+
+void ASixDOFNavmeshVolume::TickTileStreaming() {
+	if (!tileStreamer) return;
+
+	TArray<FBox> changedBounds;
+	TArray<int32> loadedCells;
+	TArray<int32> evictedCells;
+	if (tileStreamer->ApplyPendingChanges(octree, changedBounds, loadedCells, evictedCells)) octreeChanged = true;
+	for (const FBox& bounds : changedBounds) {
+		// Modifiers may have moved since the tile was baked.
+		UpdateCosts(bounds);
+		UpdateClearance(bounds.ExpandBy(layerRadii.Num() > 0 ? layerRadii.Last() : 0.f));
+	}
+
+	// Whatever was rebuilt into an evicted cell is gone, so its hash no longer describes it.
+	for (int32 index : evictedCells) {
+		cellCollisionHashes.Remove(index);
+		bakedCells.Remove(index);
+	}
+	// Loaded cells are as baked, without the dynamic obstacles, so they are checked against them again.
+	for (int32 index : loadedCells) {
+		bakedCells.Add(index);
+		MarkCellDirty(index);
+	}
+}
+
+FSixDOFOctreeSnapshot ASixDOFNavmeshVolume::GetOctreeSnapshot() const {
+	FScopeLock lock(&publishedOctreeLock);
+	return publishedOctree;
+}
+
+void ASixDOFNavmeshVolume::PublishOctree() {
+	// The copy shares every chunk of the pools with the working octree, so it costs a pointer per chunk. The worker
+	// copies a chunk the first time it writes to it afterwards, so each version only owns what changed since the last.
+	// The copy is made outside the lock, so readers only ever wait for the pointer swap.
+	FSixDOFOctreeSnapshot snapshot = MakeShared<const FSixDOFOctree, ESPMode::ThreadSafe>(octree);
+
+	{
+		FScopeLock lock(&publishedOctreeLock);
+		Swap(publishedOctree, snapshot);
+	}
+	// The previous version is freed here, or by the last search still holding it.
+	snapshot.Reset();
+	lastPublishTime = FPlatformTime::Seconds();
+	octreeChanged = false;
+}
+
+void ASixDOFNavmeshVolume::TickSnapshot() {
+	if (octreeChanged && FPlatformTime::Seconds() - lastPublishTime >= snapshotInterval) PublishOctree();
+}
+
+void ASixDOFNavmeshVolume::TickSearchRequests() {
+	int32 index;
+	while (refinementRequests.Dequeue(index)) {
+		RequestRefinement(index);
+	}
+
+	FIntVector coordinate;
+	while (tileRequests.Dequeue(coordinate)) {
+		if (tileStreamer) tileStreamer->RequestTile(coordinate);
+	}
+}
+
+void ASixDOFNavmeshVolume::SubmitSearchRequests(FSixDOFSearchState& search) {
+	if (search.requestedCells.Num() == 0 && search.requestedTiles.Num() == 0) return;
+
+	for (int32 index : search.requestedCells) {
+		refinementRequests.Enqueue(index);
+	}
+	for (const FIntVector& coordinate : search.requestedTiles) {
+		tileRequests.Enqueue(coordinate);
+	}
+	search.requestedCells.Reset();
+	search.requestedTiles.Reset();
+
+	// Refinements hold up a search, so the worker does not wait out its tick for them.
+	if (worker) worker->Wake();
+}
+
+void ASixDOFNavmeshVolume::RestartPathfindingTask(FPathfindingTask& task, const FSixDOFOctreeSnapshot& snapshot) {
+	task.octree = snapshot;
+	task.originOctant = FindOctantAtLocation(*snapshot, task.origin);
+	task.destinationOctant = FindOctantAtLocation(*snapshot, task.destination);
+	task.unrefinedCells.Reset();
+
+	StartPathfindingTask(task);
+	if (!task.originOctant.IsValid() || !task.destinationOctant.IsValid()) task.status = EPathfindingTaskStatus::Failed;
+}
+
+void ASixDOFNavmeshVolume::StartPathfindingTask(FPathfindingTask& task) {
+	const FSixDOFOctree& tree = *task.octree;
+	task.status = EPathfindingTaskStatus::InProgress;
+	task.path.Reset();
+	task.corridor.Reset();
+	task.leg = INDEX_NONE;
+	task.hierarchical = false;
+
+	const int32 numOfCrossings = tree.levels[0].Num() * 3;
+	if (hierarchicalPathfinding && task.layer == 0 && task.originOctant.IsValid() && task.destinationOctant.IsValid()
+		&& tree.cellPortals.Num() == tree.levels[0].Num() && numOfCrossings + 2 <= (int32)FOctantHandle::MaxIndex) {
+		// Within neighboring cells the corridor would be most of the search anyway.
+		const FIntVector offset = tree.GetGridCoordinate(task.destinationOctant) - tree.GetGridCoordinate(task.originOctant);
+		task.hierarchical = FMath::Max3(FMath::Abs(offset.X), FMath::Abs(offset.Y), FMath::Abs(offset.Z)) > 1;
+	}
+
+	if (!task.hierarchical) {
+		StartLeafSearch(task);
+		return;
+	}
+
+	const FOctantHandle start(0, numOfCrossings);
+	task.search->Begin();
+	task.search->FindOrAdd(start).g = 0.f;
+	task.search->Push(start, 0.f);
+}
+
+void ASixDOFNavmeshVolume::StartLeafSearch(FPathfindingTask& task) {
+	task.hierarchical = false;
+	task.path.Reset();
+	task.corridor.Reset();
+	task.leg = INDEX_NONE;
+
+	task.search->Begin();
+	if (!task.originOctant.IsValid()) return;
+
+	task.search->FindOrAdd(task.originOctant).g = 0.f;
+	task.search->Push(task.originOctant, 0.f);
 }
 
 void ASixDOFNavmeshVolume::CalculatePath(FPathfindingTask& task) {
-	FOctant* curr = task.open.Top();
-	if (!curr) {
-		task.status = EPathfindingTaskStatus::Failed;
+	if (task.hierarchical && task.leg == INDEX_NONE) {
+		CalculateCoarsePath(task);
 		return;
 	}
 
-	FOctant* destination = task.destinationOctant;
-	if (task.closed.Contains(destination)) {
-		task.status = EPathfindingTaskStatus::Successful;
+	const FSixDOFOctree& tree = *task.octree;
+	FSixDOFSearchState& search = *task.search;
+
+	FOctantHandle curr = search.Top();
+	if (!curr.IsValid()) {
+		// The corridor is only as good as the one crossing kept per face, so a leg that cannot be found is
+		// searched again on all the leaves.
+		if (task.hierarchical) StartLeafSearch(task);
+		else task.status = EPathfindingTaskStatus::Failed;
 		return;
 	}
 
-	task.open.Pop();
+	FOctantHandle destination = task.hierarchical ? task.corridor[task.leg + 1] : task.destinationOctant;
+	if (curr == destination) {
+		if (task.hierarchical) CompleteLeg(task);
+		else {
+			AppendSearchPath(task, task.originOctant, destination);
+			task.status = EPathfindingTaskStatus::Successful;
+		}
+		return;
+	}
+
+	search.Pop();
+
+	search.neighbors.Reset();
+	GetNeighbors(tree, curr, search.neighbors);
+
+	const float currG = search.Get(curr).g;
+	FVector currCenter = tree.GetCenter(curr);
+	FVector destinationCenter = tree.GetCenter(destination);
+	for (auto neighbor : search.neighbors) {
+		ENavigabilityStatus status = tree.GetStatus(neighbor);
+		if (status != ENavigabilityStatus::Navigable && status != ENavigabilityStatus::Unloaded && status != ENavigabilityStatus::Unrefined) continue;
+		if (!tree.FitsLayer(neighbor, task.layer)) continue;
+		if (task.hierarchical) {
+			const int32 cell = tree.GetCellIndex(neighbor);
+			if (cell != task.legCells[0] && cell != task.legCells[1]) continue;
+		}
+		FVector neighborCenter = tree.GetCenter(neighbor);
+		float stepCost = FVector::Dist(currCenter, neighborCenter) * tree.GetCost(neighbor);
+
+		// Unloaded cells are searched as a whole, at a penalty, and their tile is asked for so the next search
+		// through here sees the real geometry.
+		if (status == ENavigabilityStatus::Unloaded) {
+			stepCost *= unloadedTileCost;
+			if (tileStreamer) search.requestedTiles.Add(tree.GetGridCoordinate(neighbor));
+		}
+		else if (status == ENavigabilityStatus::Unrefined) {
+			stepCost *= unrefinedCellCost;
+			search.requestedCells.Add(neighbor.index);
+		}
 
-	TArray<FOctant*> neighbors;
-	GetNeighbors(curr, neighbors);
+		// Octants already expanded are opened again when a cheaper way to them turns up.
+		float g = currG + stepCost;
+		FSixDOFSearchState::FNode& node = search.FindOrAdd(neighbor);
+		if (node.g <= g) continue;
+		node.parent = curr;
+		node.g = g;
 
-	for (auto neighbor : neighbors) {
-		if (neighbor->navigatable != ENavigabilityStatus::Navigable || task.closed.Contains(neighbor)) continue;
-		task.closed.Add(neighbor, curr);
-		float cost = FVector::Dist(neighbor->center, task.destination) + FVector::Dist(curr->center, neighbor->center);
-		task.open.Push(neighbor, cost);
+		search.Push(neighbor, g + FVector::Dist(neighborCenter, destinationCenter));
 	}
 }
 
-void ASixDOFNavmeshVolume::GetNeighbors(FOctant* octant, TArray<FOctant*>& neighbors) {
-	FVector centerLocation = octant->center;
-	float offset = octant->extent.X + 1;
-	FOctant* neighbor;
+// In the coarse search, the crossing owned by a cell through its face on an axis is the node cell * 3 + axis. The
+// two nodes after the last crossing are the origin and the destination.
+static FOctantHandle GetCrossing(const FSixDOFOctree& tree, int32 index, int32 face) {
+	const int32 owner = face & 1 ? index : tree.GetAdjacentCell(index, face);
+	if (owner == INDEX_NONE || !tree.cellPortals[owner].inner[face / 2].IsValid()) return FOctantHandle();
+	return FOctantHandle(0, owner * 3 + face / 2);
+}
+
+static FVector GetCrossingPoint(const FSixDOFOctree& tree, FOctantHandle crossing) {
+	const FCellPortals& portals = tree.cellPortals[crossing.index / 3];
+	return (tree.GetCenter(portals.inner[crossing.index % 3]) + tree.GetCenter(portals.outer[crossing.index % 3])) * 0.5f;
+}
 
-	FVector left = FVector(centerLocation.X - offset, centerLocation.Y, centerLocation.Z);
-	neighbor = FindOctantAtLocation(left);
-	if (neighbor) {
-		if (octant->level < neighbor->level) AddNeighborChildren(neighbor, TArray<int32>{0, 1, 4, 5}, neighbors);
-		else neighbors.Emplace(neighbor);
+void ASixDOFNavmeshVolume::CalculateCoarsePath(FPathfindingTask& task) {
+	const FSixDOFOctree& tree = *task.octree;
+	FSixDOFSearchState& search = *task.search;
+	const int32 numOfCrossings = tree.levels[0].Num() * 3;
+	const FOctantHandle start(0, numOfCrossings);
+	const FOctantHandle goal(0, numOfCrossings + 1);
+
+	FOctantHandle curr = search.Top();
+	if (!curr.IsValid()) {
+		// Portals only know one crossing per face, so a route they miss may still exist on the leaves.
+		StartLeafSearch(task);
+		return;
 	}
 
-	FVector right = FVector(centerLocation.X + offset, centerLocation.Y, centerLocation.Z);
-	neighbor = FindOctantAtLocation(right);
-	if (neighbor) {
-		if (octant->level < neighbor->level) AddNeighborChildren(neighbor, TArray<int32>{2, 3, 6, 7}, neighbors);
-		else neighbors.Emplace(neighbor);
+	if (curr == goal) {
+		BuildCorridor(task);
+		return;
 	}
 
-	FVector back = FVector(centerLocation.X, centerLocation.Y - offset, centerLocation.Z);
-	neighbor = FindOctantAtLocation(back);
-	if (neighbor) {
-		if (octant->level < neighbor->level) AddNeighborChildren(neighbor, TArray<int32>{1, 3, 5, 7}, neighbors);
-		else neighbors.Emplace(neighbor);
+	search.Pop();
+
+	// The cells the node opens into, with the face it is on as seen from each. The origin is inside its cell.
+	int32 cells[2];
+	int32 faces[2];
+	int32 numOfCells = 1;
+	FVector currPoint = task.origin;
+	if (curr == start) {
+		cells[0] = tree.GetCellIndex(task.originOctant);
+		faces[0] = INDEX_NONE;
 	}
+	else {
+		const int32 axis = curr.index % 3;
+		cells[0] = curr.index / 3;
+		faces[0] = axis * 2 + 1;
+		cells[1] = tree.GetAdjacentCell(cells[0], faces[0]);
+		faces[1] = axis * 2;
+		numOfCells = 2;
+		currPoint = GetCrossingPoint(tree, curr);
+	}
+
+	const float currG = search.Get(curr).g;
+	const int32 destinationCell = tree.GetCellIndex(task.destinationOctant);
+	for (int32 i = 0; i < numOfCells; ++i) {
+		const int32 cell = cells[i];
+		const FOctant& octant = tree.levels[0][cell];
+
+		// Cells without children are crossed in a straight line, at their own cost or the penalty for not knowing.
+		float multiplier = 1.f;
+		if (octant.navigatable == ENavigabilityStatus::Navigable) multiplier = octant.GetCost();
+		else if (octant.navigatable == ENavigabilityStatus::Unloaded) multiplier = unloadedTileCost;
+		else if (octant.navigatable == ENavigabilityStatus::Unrefined) multiplier = unrefinedCellCost;
+
+		if (cell == destinationCell) {
+			const float g = currG + FVector::Dist(currPoint, task.destination) * multiplier;
+			FSixDOFSearchState::FNode& node = search.FindOrAdd(goal);
+			if (node.g > g) {
+				node.parent = curr;
+				node.g = g;
+				search.Push(goal, g);
+			}
+		}
+
+		for (int32 face = 0; face < 6; ++face) {
+			if (face == faces[i]) continue;
+			const FOctantHandle next = GetCrossing(tree, cell, face);
+			if (!next.IsValid()) continue;
+
+			// The origin is assumed to reach every portal of its cell. A leg that cannot falls back to the leaves.
+			float pathCost = 0.f;
+			if (faces[i] != INDEX_NONE) {
+				pathCost = tree.cellPortals[cell].costs[FCellPortals::GetFacePair(faces[i], face)];
+				if (pathCost < 0.f) continue;
+			}
+
+			const FVector nextPoint = GetCrossingPoint(tree, next);
+			const float g = currG + FMath::Max(pathCost, FVector::Dist(currPoint, nextPoint) * multiplier);
+			FSixDOFSearchState::FNode& node = search.FindOrAdd(next);
+			if (node.g <= g) continue;
+			node.parent = curr;
+			node.g = g;
 
-	FVector front = FVector(centerLocation.X, centerLocation.Y + offset, centerLocation.Z);
-	neighbor = FindOctantAtLocation(front);
-	if (neighbor) {
-		if (octant->level < neighbor->level) AddNeighborChildren(neighbor, TArray<int32>{0, 2, 4, 6}, neighbors);
-		else neighbors.Emplace(neighbor);
+			search.Push(next, g + FVector::Dist(nextPoint, task.destination));
+		}
 	}
+}
 
-	FVector bottom = FVector(centerLocation.X, centerLocation.Y, centerLocation.Z - offset);
-	neighbor = FindOctantAtLocation(bottom);
-	if (neighbor) {
-		if (octant->level < neighbor->level) AddNeighborChildren(neighbor, TArray<int32>{4, 5, 6, 7}, neighbors);
-		else neighbors.Emplace(neighbor);
+void ASixDOFNavmeshVolume::BuildCorridor(FPathfindingTask& task) {
+	const FSixDOFOctree& tree = *task.octree;
+	FSixDOFSearchState& search = *task.search;
+	const FOctantHandle start(0, tree.levels[0].Num() * 3);
+
+	TArray<FOctantHandle, TInlineAllocator<64>> crossings;
+	for (FOctantHandle node = search.Get(FOctantHandle(0, start.index + 1)).parent; node != start; node = search.Get(node).parent) {
+		crossings.Add(node);
+	}
+	Algo::Reverse(crossings);
+
+	// Each crossing becomes the leaves on either side of its face, in the order the path passes them.
+	int32 cell = tree.GetCellIndex(task.originOctant);
+	task.corridor.Reset();
+	task.corridor.Add(task.originOctant);
+	for (FOctantHandle crossing : crossings) {
+		const int32 owner = crossing.index / 3;
+		const int32 axis = crossing.index % 3;
+		const FCellPortals& portals = tree.cellPortals[owner];
+		if (cell == owner) {
+			task.corridor.Add(portals.inner[axis]);
+			task.corridor.Add(portals.outer[axis]);
+			cell = tree.GetAdjacentCell(owner, axis * 2 + 1);
+		}
+		else {
+			task.corridor.Add(portals.outer[axis]);
+			task.corridor.Add(portals.inner[axis]);
+			cell = owner;
+		}
 	}
+	task.corridor.Add(task.destinationOctant);
 
-	FVector top = FVector(centerLocation.X, centerLocation.Y, centerLocation.Z + offset);
-	neighbor = FindOctantAtLocation(top);
-	if (neighbor) {
-		if (octant->level < neighbor->level) AddNeighborChildren(neighbor, TArray<int32>{0, 1, 2, 3}, neighbors);
-		else neighbors.Emplace(neighbor);
+	// Only the cells along the corridor are refined. The legs run on this version, so they wait for the refined one.
+	for (FOctantHandle leaf : task.corridor) {
+		if (tree.GetStatus(leaf) == ENavigabilityStatus::Unrefined) task.unrefinedCells.AddUnique(tree.GetCellIndex(leaf));
+	}
+	if (task.unrefinedCells.Num() > 0) {
+		search.requestedCells.Append(task.unrefinedCells);
+		return;
 	}
+
+	task.leg = 0;
+	StartLeg(task);
+}
+
+void ASixDOFNavmeshVolume::StartLeg(FPathfindingTask& task) {
+	const FSixDOFOctree& tree = *task.octree;
+	const FOctantHandle from = task.corridor[task.leg];
+	task.legCells[0] = tree.GetCellIndex(from);
+	task.legCells[1] = tree.GetCellIndex(task.corridor[task.leg + 1]);
+
+	task.search->Begin();
+	task.search->FindOrAdd(from).g = 0.f;
+	task.search->Push(from, 0.f);
 }
 
-void ASixDOFNavmeshVolume::AddNeighborChildren(FOctant* neighbor, TArray<int32> indices, TArray<FOctant*>& neighbors) {
-	TArray<FOctant> children = neighbor->children;
-	if (children.Num() == 0) {
-		neighbors.Emplace(neighbor);
+void ASixDOFNavmeshVolume::CompleteLeg(FPathfindingTask& task) {
+	AppendSearchPath(task, task.corridor[task.leg], task.corridor[task.leg + 1]);
+	// A leg through a cell that was not subdivided is a guess, so the task waits for a version that has it.
+	if (task.unrefinedCells.Num() > 0) {
+		task.search->requestedCells.Append(task.unrefinedCells);
 		return;
 	}
-	else {
-		for (int i = 0; i < indices.Num(); ++i) {
-			AddNeighborChildren(&children[indices[i]], indices, neighbors);
+
+	++task.leg;
+	if (task.leg == task.corridor.Num() - 1) {
+		task.status = EPathfindingTaskStatus::Successful;
+		return;
+	}
+
+	// Legs alternate between searching a cell and stepping across a face, and the path is reported after each cell.
+	if (task.leg % 2 == 1) PublishPath(task, false);
+	StartLeg(task);
+}
+
+void ASixDOFNavmeshVolume::AppendSearchPath(FPathfindingTask& task, FOctantHandle from, FOctantHandle to) {
+	const FSixDOFOctree& tree = *task.octree;
+	const int32 first = task.path.Num();
+	if (tree.GetStatus(to) == ENavigabilityStatus::Unrefined) task.unrefinedCells.AddUnique(to.index);
+
+	FOctantHandle prev = to;
+	while (prev != from) {
+		FOctantHandle next = task.search->Get(prev).parent;
+		if (tree.GetStatus(next) == ENavigabilityStatus::Unrefined) task.unrefinedCells.AddUnique(next.index);
+		task.path.Add(tree.GetCenter(next));
+		prev = next;
+	}
+	Algo::Reverse(MakeArrayView(task.path).Slice(first, task.path.Num() - first));
+}
+
+void ASixDOFNavmeshVolume::PublishPath(const FPathfindingTask& task, bool complete) {
+	pathUpdates.Enqueue({ task.actor, task.path, complete });
+}
+
+void ASixDOFNavmeshVolume::GetNeighbors(const FSixDOFOctree& tree, FOctantHandle handle, TArray<FOctantHandle>& neighbors) {
+	if (tree.IsSubvoxel(handle)) {
+		GetSubvoxelNeighbors(tree, handle, neighbors);
+		return;
+	}
+
+	const FOctantLinks& links = tree.GetLinks(handle);
+	for (int32 face = 0; face < 6; ++face) {
+		if (links.faces[face].IsValid()) AddNeighborChildren(tree, links.faces[face], face, neighbors);
+	}
+}
+
+void ASixDOFNavmeshVolume::GetSubvoxelNeighbors(const FSixDOFOctree& tree, FOctantHandle handle, TArray<FOctantHandle>& neighbors) {
+	const int32 maskIndex = handle.index / FSixDOFOctree::SubvoxelsPerLeaf;
+	const uint64 bit = handle.index % FSixDOFOctree::SubvoxelsPerLeaf;
+	const FOctantLinks& ownerLinks = tree.GetLinks(tree.GetOwner(handle));
+
+	// Steps are Morton increments on the bit index. A step off the edge of the mask wraps to the opposite edge,
+	// which is the touching sub-voxel when the owner's neighbor has a mask of its own.
+	for (int32 axis = 0; axis < 3; ++axis) {
+		const uint64 axisMask = SixDOFMorton::AxisMask(axis) & 63;
+
+		const uint64 lower = SixDOFMorton::DecrementAxis(bit, axisMask) & 63;
+		if ((bit & axisMask) != 0) neighbors.Emplace(tree.GetSubvoxel(maskIndex, (int32)lower));
+		else AddSubvoxelNeighbor(tree, ownerLinks.faces[axis * 2], (int32)lower, neighbors);
+
+		const uint64 upper = SixDOFMorton::IncrementAxis(bit, axisMask) & 63;
+		if ((bit & axisMask) != axisMask) neighbors.Emplace(tree.GetSubvoxel(maskIndex, (int32)upper));
+		else AddSubvoxelNeighbor(tree, ownerLinks.faces[axis * 2 + 1], (int32)upper, neighbors);
+	}
+}
+
+void ASixDOFNavmeshVolume::AddSubvoxelNeighbor(const FSixDOFOctree& tree, FOctantHandle link, int32 bit, TArray<FOctantHandle>& neighbors) {
+	if (!link.IsValid()) return;
+
+	const FOctant& neighbor = tree.Get(link);
+	if (neighbor.navigatable == ENavigabilityStatus::HasSubvoxels) neighbors.Emplace(tree.GetSubvoxel(neighbor.firstChild, bit));
+	else neighbors.Emplace(link);
+}
+
+void ASixDOFNavmeshVolume::AddNeighborChildren(const FSixDOFOctree& tree, FOctantHandle neighbor, int32 face, TArray<FOctantHandle>& neighbors) {
+	const FOctant& octant = tree.Get(neighbor);
+	if (octant.navigatable == ENavigabilityStatus::HasChildren) {
+		for (int32 childIndex : FSixDOFOctree::FaceChildren[face]) {
+			AddNeighborChildren(tree, tree.GetChild(neighbor, childIndex), face, neighbors);
+		}
+	}
+	else if (octant.navigatable == ENavigabilityStatus::HasSubvoxels) {
+		// Only the open sub-voxels on the touching face are worth returning.
+		uint64 open = FSixDOFOctree::FaceSubvoxels[face] & ~tree.subvoxelMasks[octant.firstChild];
+		while (open) {
+			neighbors.Emplace(tree.GetSubvoxel(octant.firstChild, (int32)FMath::CountTrailingZeros64(open)));
+			open &= open - 1;
 		}
 	}
+	else neighbors.Emplace(neighbor);
 }
 
 
-bool ASixDOFNavmeshVolume::SchedulePathfindingTask(AActor* actor, FVector destination) {
-	FOctant* destinationOctant = FindOctantAtLocation(destination);
-	if (!destinationOctant) {
+bool ASixDOFNavmeshVolume::SchedulePathfindingTask(AActor* actor, FVector destination, float agentRadius) {
+	const FSixDOFOctreeSnapshot snapshot = GetOctreeSnapshot();
+	if (!snapshot) return false;
+
+	FOctantHandle destinationOctant = FindOctantAtLocation(*snapshot, destination);
+	if (!destinationOctant.IsValid()) {
 		UE_LOG(LogTemp, Warning, TEXT("Destination is out-of-bounds."));
 		return false;
 	}
 
-	FOctant* originOctant = FindOctantAtLocation(actor->GetActorLocation());
-	if (!originOctant) {
+	FOctantHandle originOctant = FindOctantAtLocation(*snapshot, actor->GetActorLocation());
+	if (!originOctant.IsValid()) {
 		UE_LOG(LogTemp, Warning, TEXT("Origin is out-of-bounds."));
 		return false;
 	}
 
-	FPathfindingTask task(actor, actor->GetActorLocation(), destination, originOctant, destinationOctant);
-	task.open.Push(originOctant, originOctant->cost);
+	FPathfindingTask task(actor, actor->GetActorLocation(), destination, originOctant, destinationOctant, snapshot);
+	if (agentRadius > 0.f) {
+		task.layer = Algo::LowerBound(layerRadii, agentRadius) + 1;
+		if (task.layer > layerRadii.Num()) {
+			UE_LOG(LogTemp, Warning, TEXT("No agent layer is large enough for a radius of %f, using the largest."), agentRadius);
+			task.layer = layerRadii.Num();
+		}
+	}
+
+	if (pathfinders.Num() == 0) return false;
+	task.startTime = FPlatformTime::Seconds();
 
 	UE_LOG(LogTemp, Warning, TEXT("Task scheduled!"));
-	activePathfindingTasks.Add(task);
+	SixDOFNavmeshPathfinder* target = pathfinders[nextPathfinder];
+	nextPathfinder = (nextPathfinder + 1) % pathfinders.Num();
+	const bool targetIdle = target->IsIdle();
+	target->Enqueue(MoveTemp(task));
+
+	// A busy thread would only get to the task after its current turns, so the idle ones are woken to steal it. An
+	// idle thread may have no room for it, so all of them are.
+	if (!targetIdle) {
+		for (SixDOFNavmeshPathfinder* pathfinder : pathfinders) {
+			if (pathfinder != target) pathfinder->WakeIfIdle();
+		}
+	}
 	return true;
 }
 
 
 
-TArray<FOctant*> ASixDOFNavmeshVolume::FindNeighbors(FOctant* octant) {
-	TArray<FOctant*> neighbors;
-
-	int32 left = octant->xIndex - 1;
-	int32 right = octant->xIndex + 1;
+TArray<FOctantHandle> ASixDOFNavmeshVolume::FindNeighbors(FOctantHandle handle) {
+	TArray<FOctantHandle> neighbors;
 
-	int32 back = octant->yIndex - 1;
-	int32 front = octant->yIndex + 1;
+	FIntVector index = octree.GetGridCoordinate(handle);
+	FOctantHandle neighbor;
 
-	int32 bottom = octant->zIndex - 1;
-	int32 top = octant->zIndex + 1;
+	neighbor = octree.GetTopLevel(index.X - 1, index.Y, index.Z);
+	if (neighbor.IsValid()) neighbors.Emplace(neighbor);
+	neighbor = octree.GetTopLevel(index.X + 1, index.Y, index.Z);
+	if (neighbor.IsValid()) neighbors.Emplace(neighbor);
 
-	if (left >= 0) neighbors.Emplace(&octants[left][octant->yIndex][octant->zIndex]);
-	if (right < octants.Num()) neighbors.Emplace(&octants[right][octant->yIndex][octant->zIndex]);
+	neighbor = octree.GetTopLevel(index.X, index.Y - 1, index.Z);
+	if (neighbor.IsValid()) neighbors.Emplace(neighbor);
+	neighbor = octree.GetTopLevel(index.X, index.Y + 1, index.Z);
+	if (neighbor.IsValid()) neighbors.Emplace(neighbor);
 
-	if (back >= 0) neighbors.Emplace(&octants[octant->xIndex][back][octant->zIndex]);
-	if (front < octants[octant->xIndex].Num()) neighbors.Emplace(&octants[octant->xIndex][front][octant->zIndex]);
-
-	if (bottom >= 0) neighbors.Emplace(&octants[octant->xIndex][octant->yIndex][bottom]);
-	if (top < octants[octant->xIndex][octant->yIndex].Num()) neighbors.Emplace(&octants[octant->xIndex][octant->yIndex][top]);
+	neighbor = octree.GetTopLevel(index.X, index.Y, index.Z - 1);
+	if (neighbor.IsValid()) neighbors.Emplace(neighbor);
+	neighbor = octree.GetTopLevel(index.X, index.Y, index.Z + 1);
+	if (neighbor.IsValid()) neighbors.Emplace(neighbor);
 
 	return neighbors;
 }
 
 
-FOctant* ASixDOFNavmeshVolume::FindOctantAtIndex(int32 x, int32 y, int32 z, int32 level) {
-	return nullptr;
+FOctantHandle ASixDOFNavmeshVolume::FindOctantAtIndex(int32 x, int32 y, int32 z, int32 level) {
+	return octree.FindLeafAtCoordinate(FIntVector(x, y, z), level);
 }
 
-FOctant* ASixDOFNavmeshVolume::FindOctantAtLocation(FVector location) {
-	int32 x = (location.X - GetActorLocation().X) / octantSize;
-	int32 y = (location.Y - GetActorLocation().Y) / octantSize;
-	int32 z = (location.Z - GetActorLocation().Z) / octantSize;
-
-	FOctant* octant = (octants.IsValidIndex(x) && octants[x].IsValidIndex(y) && octants[x][y].IsValidIndex(z)) ? &octants[x][y][z] : nullptr;
-	if (!octant) return nullptr;
-
-	if (octant->navigatable == ENavigabilityStatus::HasChildren) return FindOctantWithinChildren(location, octant->children);
+FOctantHandle ASixDOFNavmeshVolume::FindOctantAtLocation(const FSixDOFOctree& tree, FVector location) {
+	return tree.FindLeafAtLocation(location);
+}
 
-	return octant;
+TArray<FOctantHandle> ASixDOFNavmeshVolume::FindOctantsAroundMesh(const FSixDOFOctree& tree, UPrimitiveComponent* mesh) {
+	TArray<FOctantHandle> octantsAroundMesh;
+	tree.FindLeavesInBox(mesh->Bounds.GetBox(), octantsAroundMesh, false);
+	return octantsAroundMesh;
 }
 
-FOctant* ASixDOFNavmeshVolume::FindOctantWithinChildren(FVector location, TArray<FOctant>& children) {
-	for (auto iter = children.begin(); iter != children.end(); ++iter) {
-		FOctant& child = *iter;
-		FVector max = child.center + child.extent;
-		FVector min = child.center - child.extent;
+void ASixDOFNavmeshVolume::UpdateClearance(const FBox& bounds) {
+	if (layerRadii.Num() == 0) return;
+	octree.GrowLayers();
 
-		if (min.X <= location.X && location.X <= max.X &&
-			min.Y <= location.Y && location.Y <= max.Y &&
-			min.Z <= location.Z && location.Z <= max.Z) {
-			if (child.navigatable == ENavigabilityStatus::HasChildren) return FindOctantWithinChildren(location, child.children);
-			return &child;
-		}
+	// Leaves further than the largest radius from bounds cannot be the nearest obstacle of a leaf inside it.
+	const float maxRadius = layerRadii.Last();
+	TArray<FOctantHandle> leaves;
+	octree.FindLeavesInBox(bounds.ExpandBy(maxRadius), leaves);
+
+	// Brushfire from every blocked leaf: each reached leaf remembers its nearest blocked leaf, and passes it on to
+	// its neighbors, which measure their own distance to it.
+	struct FClearanceEntry
+	{
+		float distance;
+		FOctantHandle leaf;
+		FOctantHandle source;
+
+		bool operator<(const FClearanceEntry& other) const { return distance < other.distance; }
+	};
+
+	TSet<FOctantHandle> inRegion(leaves);
+	TMap<FOctantHandle, float> distances;
+	TArray<FClearanceEntry> heap;
+	for (FOctantHandle leaf : leaves) {
+		if (octree.GetStatus(leaf) != ENavigabilityStatus::NonNavigable) continue;
+		distances.Add(leaf, 0.f);
+		heap.HeapPush({ 0.f, leaf, leaf });
 	}
 
-	return nullptr;
-}
+	TArray<FOctantHandle> neighbors;
+	while (heap.Num() > 0) {
+		FClearanceEntry entry;
+		heap.HeapPop(entry, false);
+		if (distances[entry.leaf] < entry.distance) continue;
 
-TArray<FOctant*> ASixDOFNavmeshVolume::FindOctantsAroundMesh(UPrimitiveComponent* mesh) {
-	TArray<FOctant*> octantsAroundMesh;
+		const FVector sourceCenter = octree.GetCenter(entry.source);
+		const FVector sourceExtent = octree.GetExtent(entry.source);
+		const FBox sourceBox(sourceCenter - sourceExtent, sourceCenter + sourceExtent);
 
-	FVector meshExtents = mesh->Bounds.BoxExtent;
-	FVector meshMinBounds = (mesh->Bounds.Origin - meshExtents);
-	FVector meshMaxBounds = (mesh->Bounds.Origin + meshExtents);
+		neighbors.Reset();
+		GetNeighbors(octree, entry.leaf, neighbors);
+		for (FOctantHandle neighbor : neighbors) {
+			if (!inRegion.Contains(neighbor) || octree.GetStatus(neighbor) == ENavigabilityStatus::NonNavigable) continue;
 
-	for (int32 x = meshMinBounds.X; x <= meshMaxBounds.X; x++)
-	{
-		for (int32 y = meshMinBounds.Y; y <= meshMaxBounds.Y; y++)
-		{
-			for (int32 z = meshMinBounds.Z; z <= meshMaxBounds.Z; z++)
-			{
-				FOctant* octant = FindOctantAtLocation(FVector(x, y, z));
-				if (octant && !octantsAroundMesh.Contains(octant)) octantsAroundMesh.Add(octant);
-			}
+			const float distance = FMath::Sqrt(sourceBox.ComputeSquaredDistanceToPoint(octree.GetCenter(neighbor)));
+			if (distance >= maxRadius) continue;
+
+			float* known = distances.Find(neighbor);
+			if (known && *known <= distance) continue;
+			distances.Add(neighbor, distance);
+			heap.HeapPush({ distance, neighbor, entry.source });
 		}
 	}
 
-	return octantsAroundMesh;
-}
+	for (FOctantHandle leaf : leaves) {
+		if (!bounds.IsInsideOrOn(octree.GetCenter(leaf))) continue;
 
-void ASixDOFNavmeshVolume::GenerateVoxelGrid() {
-	float xPos = GetActorLocation().X;
-	float yPos = GetActorLocation().Y;
-	float zPos = GetActorLocation().Z;
+		const float* distance = distances.Find(leaf);
+		const int32 numOfFittingLayers = distance ? Algo::UpperBound(layerRadii, *distance) + 1 : layerRadii.Num() + 1;
+		octree.SetClearance(leaf, numOfFittingLayers);
+	}
+}
 
-	FVector boxScale = navmeshVolumeBounds->GetScaledBoxExtent() * 2;
-	int32 xSize = FMath::CeilToInt(boxScale.X / octantSize);
-	int32 ySize = FMath::CeilToInt(boxScale.Y / octantSize);
-	int32 zSize = FMath::CeilToInt(boxScale.Z / octantSize);
+void ASixDOFNavmeshVolume::GenerateVoxelGrid(bool lazily) {
+	FIntVector gridSize = GetGridSize();
+	int32 xSize = gridSize.X;
+	int32 ySize = gridSize.Y;
+	int32 zSize = gridSize.Z;
 
 	double start = FPlatformTime::Seconds();
 
+	if ((int64)xSize * ySize * zSize > FOctantHandle::MaxIndex) {
+		UE_LOG(LogTemp, Error, TEXT("A grid of %i x %i x %i cells does not fit in octree handles, refusing to build. Raise the octant size."), xSize, ySize, zSize);
+		octree.Empty();
+		return;
+	}
+	if (!SixDOFMorton::FitsGrid(gridSize, maxSubdivisionLevel)) {
+		UE_LOG(LogTemp, Error, TEXT("A grid of %i x %i x %i cells subdivided %i times does not fit in Morton codes, refusing to build. Raise the octant size or lower the max subdivision level."), xSize, ySize, zSize, maxSubdivisionLevel);
+		octree.Empty();
+		return;
+	}
+
+	octree.Init(GetActorLocation(), octantSize, FIntVector(xSize, ySize, zSize), maxSubdivisionLevel);
+	cellCollisionHashes.Reset();
+
 	int32 id = 0;
-	octants.Reserve(xSize);
 	for (int i = 0; i < xSize; ++i) {
-		octants.Emplace();
-		octants[i].Reserve(ySize);
 		for (int j = 0; j < ySize; ++j) {
-			octants[i].Emplace();
-			octants[i][j].Reserve(zSize);
 			for (int k = 0; k < zSize; ++k) {
-				FOctant octant;
-
-				octant.id = id;
+				FOctant& octant = octree.levels[0].AddDefaulted_GetRef();
 				++id;
 
-				octant.xIndex = i;
-				octant.yIndex = j;
-				octant.zIndex = k;
+				octant.mortonCode = SixDOFMorton::Encode(i, j, k);
+			}
+		}
+	}
+
+	double allocated = FPlatformTime::Seconds();
+
+	if (lazily) {
+		// One overlap per cell, which reads every region, so the whole volume is gathered up front on this thread.
+		// Occupied cells are subdivided later by the worker, against the same shapes.
+		GatherStaticCollision();
+		rasterizer = staticCollision[0].Get();
+		ParallelFor(id, [&](int32 i) {
+			const FOctantHandle handle(0, i);
+			if (rasterizer->Overlaps(octree.GetCenter(handle), octree.GetExtent(handle))) octree.levels[0][i].navigatable = ENavigabilityStatus::Unrefined;
+		});
+		// Cells left to refine are hashed when the worker refines them.
+		SeedCellCollisionHashes();
+		rasterizer = nullptr;
+
+		unrefinedCells.Reset();
+		nextUnrefinedCell = 0;
+		for (int32 i = 0; i < id; ++i) {
+			if (octree.levels[0][i].navigatable == ENavigabilityStatus::Unrefined) unrefinedCells.Add(i);
+		}
 
-				float x = octantSize * i + xPos + (octantSize / 2);
-				float y = octantSize * j + yPos + (octantSize / 2);
-				float z = octantSize * k + zPos + (octantSize / 2);
+		octree.BuildLinks();
+		UpdateCosts(FBox(octree.origin, octree.origin + FVector(gridSize) * octantSize));
+		octree.InitLayers(layerRadii.Num() + 1);
+		UpdateClearance(FBox(octree.origin, octree.origin + FVector(gridSize) * octantSize));
 
-				octant.center = FVector(x, y, z);
-				octant.extent = FVector(octantSize, octantSize, octantSize) * 0.5;
+		double end = FPlatformTime::Seconds();
+		UE_LOG(LogTemp, Warning, TEXT("Classified grid of %i octants (%i to refine) in %f seconds."), id, unrefinedCells.Num(), end - start);
+		return;
+	}
 
-				SubdivideOctree(octant);
-				octants[i][j].Emplace(octant);
-			}
+	// Gathered up front on this thread, so the rasterizer's build tasks below never touch the world. The physics
+	// backend queries the scene from the tasks instead, and leaves the regions to the worker.
+	if (buildBackend == EOctreeBuildBackend::Rasterizer) {
+		GatherStaticCollision();
+		rasterizer = staticCollision[0].Get();
+	}
+
+	// Top-level cells are independent, so each task subdivides a contiguous run of them into its own buffer.
+	// Stitching the buffers back in order gives the same layout as a serial build.
+	const int32 numOfBuffers = FMath::Min(FTaskGraphInterface::Get().GetNumWorkerThreads() * 4, id);
+	const int32 octantsPerBuffer = numOfBuffers > 0 ? FMath::DivideAndRoundUp(id, numOfBuffers) : 0;
+	TArray<FSixDOFOctree> buffers;
+	buffers.SetNum(numOfBuffers);
+
+	ParallelFor(numOfBuffers, [&](int32 bufferIndex) {
+		FSixDOFOctree& buffer = buffers[bufferIndex];
+		buffer.InitBuffer(octree);
+
+		const int32 first = bufferIndex * octantsPerBuffer;
+		const int32 last = FMath::Min(first + octantsPerBuffer, id);
+		for (int32 i = first; i < last; ++i) {
+			buffer.levels[0].Add(octree.levels[0][i]);
+			SubdivideOctree(buffer, FOctantHandle(0, i - first));
+		}
+	});
+	double subdivided = FPlatformTime::Seconds();
+
+	TArray<int32> topLevelIndices;
+	bool exhausted = false;
+	for (int32 i = 0; i < numOfBuffers && !exhausted; ++i) {
+		topLevelIndices.Reset();
+		for (int32 j = i * octantsPerBuffer; j < FMath::Min((i + 1) * octantsPerBuffer, id); ++j) {
+			topLevelIndices.Add(j);
 		}
+		exhausted = buffers[i].exhausted || !octree.Append(buffers[i], topLevelIndices);
 	}
-	double end = FPlatformTime::Seconds();
-	UE_LOG(LogTemp, Warning, TEXT("Created grid of %i octants in %f seconds."), id, end - start);
+	buffers.Empty();
+	double stitched = FPlatformTime::Seconds();
 
-	TArray<AActor*> navModifierActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ASixDOFNavmeshModifier::StaticClass(), navModifierActors);
-	for (auto actor : navModifierActors) {
-		ASixDOFNavmeshModifier* navModifier = Cast<ASixDOFNavmeshModifier>(actor);
-		if (navModifier) modifiers.Add(navModifier);
+	if (rasterizer && !exhausted) SeedCellCollisionHashes();
+	rasterizer = nullptr;
+
+	// A partial octree would block whatever did not fit, so nothing is kept.
+	if (exhausted) {
+		UE_LOG(LogTemp, Error, TEXT("The octree has more nodes than its handles can address, refusing to build. Raise the octant size or lower the subdivision level."));
+		octree.Empty();
+		return;
 	}
 
+	octree.BuildLinks();
+	double linked = FPlatformTime::Seconds();
+
+	const FBox volumeBounds(octree.origin, octree.origin + FVector(gridSize) * octantSize);
+	UpdateCosts(volumeBounds);
+	double costed = FPlatformTime::Seconds();
+
+	octree.InitLayers(layerRadii.Num() + 1);
+	UpdateClearance(volumeBounds);
+	double end = FPlatformTime::Seconds();
+	UE_LOG(LogTemp, Warning, TEXT("Created grid of %i octants (%i nodes) in %f seconds (allocate %f, subdivide %f on %i tasks, stitch %f, link %f, costs %f, clearance %f)."),
+		id, octree.Num(), end - start, allocated - start, subdivided - allocated, numOfBuffers, stitched - subdivided, linked - stitched, costed - linked, end - costed);
+
 	//DrawDebugNavmesh();
 }
 
-bool ASixDOFNavmeshVolume::CheckOctantCollision(FOctant& octant) {
-	const int32 totalCellCount = 125;
-	const int32 countUntilEarlyExit = totalCellCount * (percentUntilConsideredFull * .01f);
-	int32 occupiedCellCount = 0;
+// Sub-cell coordinates in Morton order, so four consecutive sub-cells land on four consecutive occupancy bits.
+struct FSubcellOffsets
+{
+	alignas(16) float x[FSixDOFOctree::SubvoxelsPerLeaf];
+	alignas(16) float y[FSixDOFOctree::SubvoxelsPerLeaf];
+	alignas(16) float z[FSixDOFOctree::SubvoxelsPerLeaf];
+
+	FSubcellOffsets() {
+		for (int32 i = 0; i < FSixDOFOctree::SubvoxelsPerLeaf; ++i) {
+			FIntVector coordinate = SixDOFMorton::Decode(i);
+			x[i] = coordinate.X;
+			y[i] = coordinate.Y;
+			z[i] = coordinate.Z;
+		}
+	}
+};
+static const FSubcellOffsets SubcellOffsets;
+
+bool ASixDOFNavmeshVolume::FindOverlappingComponents(const FVector& center, const FVector& extent, const FOverlappingComponents* candidates, FOverlappingComponents& outComponents) {
+	outComponents.Reset();
+	FCollisionShape shape = FCollisionShape::MakeBox(extent);
+
+	// A child can only overlap what its parent overlaps, so the parent's primitives are tested one at a time
+	// against the child instead of querying the whole scene again. Primitives without a single body to test
+	// make the candidates ambiguous.
+	bool ambiguous = candidates == nullptr;
+	if (candidates) {
+		const FBox box(center - extent, center + extent);
+		for (UPrimitiveComponent* component : *candidates) {
+			if (!component->Bounds.GetBox().Intersect(box)) continue;
+
+			FBodyInstance* body = component->GetBodyInstance();
+			if (!body || !body->IsValidBodyInstance()) {
+				ambiguous = true;
+				break;
+			}
+			if (component->OverlapComponent(center, FQuat::Identity, shape)) outComponents.Add(component);
+		}
+	}
+	if (!ambiguous) return outComponents.Num() > 0;
 
+	outComponents.Reset();
 	TArray<FOverlapResult> outOverlaps;
-	FCollisionShape shape = FCollisionShape::MakeBox(octant.extent);
-	bool overlapped = GetWorld()->OverlapMultiByObjectType(outOverlaps, octant.center, FQuat::Identity, octantCollisionObjectQueryParams, shape, octantCollisionQueryParams);
-
-	if (overlapped) {
-		octant.navigatable = ENavigabilityStatus::NonNavigable;
-
-		FVector fractionExtent = shape.GetExtent() * 0.2f;
-		float size = shape.GetBox().Size();
-		const FVector dimension = FVector(size * .2f, size * .2f, size * .2f);
-
-		FVector minBounds = octant.center - shape.GetExtent();
-		FVector maxBounds = octant.center + shape.GetExtent();
-		FVector cellSize = (maxBounds - minBounds) / 5;
-
-		for (int32 X = 0; X < 5; X++) {
-			for (int32 Y = 0; Y < 5; Y++) {
-				for (int32 Z = 0; Z < 5; Z++) {
-					if (occupiedCellCount >= countUntilEarlyExit) return true;
-
-					FVector cellCenter = minBounds + FVector(X + 0.5f, Y + 0.5f, Z + 0.5f) * cellSize;
-					FBox collisionShape(cellCenter - fractionExtent, cellCenter + fractionExtent);
-
-					for (int32 j = 0; j < outOverlaps.Num(); ++j) {
-						const FBox& actorShape = outOverlaps[j].GetActor()->GetComponentsBoundingBox();
-
-						if (collisionShape.Min.X <= actorShape.Max.X && collisionShape.Max.X >= actorShape.Min.X &&
-							collisionShape.Min.Y <= actorShape.Max.Y && collisionShape.Max.Y >= actorShape.Min.Y &&
-							collisionShape.Min.Z <= actorShape.Max.Z && collisionShape.Max.Z >= actorShape.Min.Z) {
-							++occupiedCellCount;
-							break;
-						}
-					}
-				}
-			}
+	GetWorld()->OverlapMultiByObjectType(outOverlaps, center, FQuat::Identity, octantCollisionObjectQueryParams, shape, octantCollisionQueryParams);
+	for (auto& overlap : outOverlaps) {
+		UPrimitiveComponent* component = overlap.GetComponent();
+		if (component) outComponents.AddUnique(component);
+	}
+	return outComponents.Num() > 0;
+}
+
+float ASixDOFNavmeshVolume::CheckOctantCollision(FSixDOFOctree& tree, FOctantHandle handle, uint64& occupancy, const FOverlappingComponents* candidates, FOverlappingComponents& components) {
+	occupancy = 0;
+	FOctant& octant = tree.Get(handle);
+	const FVector center = tree.GetCenter(handle);
+	const FVector extent = tree.GetExtent(handle);
+
+	if (rasterizer) {
+		bool overlapped = rasterizer->Rasterize(center, extent, occupancy, dynamicShapes ? &dynamicShapes->owners : nullptr);
+		if (dynamicShapes) {
+			uint64 dynamicOccupancy = 0;
+			overlapped |= dynamicShapes->shapes.Rasterize(center, extent, dynamicOccupancy);
+			occupancy |= dynamicOccupancy;
 		}
+
+		if (overlapped) octant.navigatable = ENavigabilityStatus::NonNavigable;
+		return FPlatformMath::CountBits(occupancy) / (float)FSixDOFOctree::SubvoxelsPerLeaf;
+	}
+
+	if (!FindOverlappingComponents(center, extent, candidates, components)) return 0.f;
+
+	octant.navigatable = ENavigabilityStatus::NonNavigable;
+
+	// Bounds are read once per primitive here rather than once per sub-cell and overlap.
+	const FVector3f minBounds = FVector3f(center - extent);
+	const FVector3f cellSize = FVector3f(extent) * 0.5f;
+	const VectorRegister4Float minX = VectorSetFloat1(minBounds.X);
+	const VectorRegister4Float minY = VectorSetFloat1(minBounds.Y);
+	const VectorRegister4Float minZ = VectorSetFloat1(minBounds.Z);
+	const VectorRegister4Float cellSizeX = VectorSetFloat1(cellSize.X);
+	const VectorRegister4Float cellSizeY = VectorSetFloat1(cellSize.Y);
+	const VectorRegister4Float cellSizeZ = VectorSetFloat1(cellSize.Z);
+
+	// Each primitive's box is tested against four sub-cells per step. The 4x4x4 cells line up with the sub-voxels
+	// two levels down, so the same pass fills the occupancy mask.
+	for (UPrimitiveComponent* component : components) {
+		const FBox box = component->Bounds.GetBox();
+		const VectorRegister4Float boxMinX = VectorSetFloat1((float)box.Min.X);
+		const VectorRegister4Float boxMinY = VectorSetFloat1((float)box.Min.Y);
+		const VectorRegister4Float boxMinZ = VectorSetFloat1((float)box.Min.Z);
+		const VectorRegister4Float boxMaxX = VectorSetFloat1((float)box.Max.X);
+		const VectorRegister4Float boxMaxY = VectorSetFloat1((float)box.Max.Y);
+		const VectorRegister4Float boxMaxZ = VectorSetFloat1((float)box.Max.Z);
+
+		for (int32 i = 0; i < FSixDOFOctree::SubvoxelsPerLeaf; i += 4) {
+			const VectorRegister4Float cellMinX = VectorMultiplyAdd(VectorLoadAligned(&SubcellOffsets.x[i]), cellSizeX, minX);
+			const VectorRegister4Float cellMinY = VectorMultiplyAdd(VectorLoadAligned(&SubcellOffsets.y[i]), cellSizeY, minY);
+			const VectorRegister4Float cellMinZ = VectorMultiplyAdd(VectorLoadAligned(&SubcellOffsets.z[i]), cellSizeZ, minZ);
+
+			VectorRegister4Float overlap = VectorBitwiseAnd(VectorCompareLE(cellMinX, boxMaxX), VectorCompareGE(VectorAdd(cellMinX, cellSizeX), boxMinX));
+			overlap = VectorBitwiseAnd(overlap, VectorBitwiseAnd(VectorCompareLE(cellMinY, boxMaxY), VectorCompareGE(VectorAdd(cellMinY, cellSizeY), boxMinY)));
+			overlap = VectorBitwiseAnd(overlap, VectorBitwiseAnd(VectorCompareLE(cellMinZ, boxMaxZ), VectorCompareGE(VectorAdd(cellMinZ, cellSizeZ), boxMinZ)));
+			occupancy |= (uint64)VectorMaskBits(overlap) << i;
+		}
+
+		if (occupancy == ~0ull) break;
 	}
 
-	return false;
+	return FPlatformMath::CountBits(occupancy) / (float)FSixDOFOctree::SubvoxelsPerLeaf;
 }
 
-void ASixDOFNavmeshVolume::SubdivideOctree(FOctant& octant) {
-	bool octantFilled = CheckOctantCollision(octant);
-	if (octant.level == maxSubdivisionLevel || octant.navigatable == ENavigabilityStatus::Navigable || octantFilled) return;
+void ASixDOFNavmeshVolume::SubdivideOctree(FSixDOFOctree& tree, FOctantHandle handle, const FOverlappingComponents* candidates) {
+	FOctant& octant = tree.Get(handle);
+	const bool isDeepestLevel = handle.level == tree.maxLevel;
+	uint64 occupancy = 0;
+	FOverlappingComponents components;
+	bool octantFilled = CheckOctantCollision(tree, handle, occupancy, candidates, components) >= percentUntilConsideredFull * .01f;
+	if (octant.navigatable == ENavigabilityStatus::Navigable || octantFilled) return;
+
+	// Nodes that run out of handle indices stay blocked, see FSixDOFOctree::exhausted.
+	if (isDeepestLevel) {
+		octant.navigatable = occupancy ? ENavigabilityStatus::HasSubvoxels : ENavigabilityStatus::Navigable;
+		if (occupancy && !tree.SetSubvoxels(handle, occupancy)) octant.navigatable = ENavigabilityStatus::NonNavigable;
+		return;
+	}
 
+	int32 firstChild = tree.AllocateChildren(handle);
+	if (firstChild == INDEX_NONE) return;
 	octant.navigatable = ENavigabilityStatus::HasChildren;
-	octant.children.Reserve(8);
-	FVector quarterSize = octant.extent * 0.5f;
 	for (int i = 0; i < 8; ++i) {
-		FVector center;
-		center.X = (i & 1) ? quarterSize.X : -quarterSize.X;
-		center.Y = (i & 2) ? quarterSize.Y : -quarterSize.Y;
-		center.Z = (i & 4) ? quarterSize.Z : -quarterSize.Z;
-		center += octant.center;
-
-		FOctant child;
-		child.center = center;
-		child.extent = quarterSize;
-		child.level = octant.level + 1;
-		child.index = i;
-		child.parent = &octant;
-
-		child.xIndex = octant.xIndex;
-		child.yIndex = octant.yIndex;
-		child.zIndex = octant.zIndex;
+		FOctant& child = tree.levels[handle.level + 1][firstChild + i];
+		child.Reset();
+		child.mortonCode = (octant.mortonCode << 3) | i;
 
-		SubdivideOctree(child);
-		octant.children.Add(child);
+		SubdivideOctree(tree, FOctantHandle(handle.level + 1, firstChild + i), &components);
 	}
 }
 
-void ASixDOFNavmeshVolume::DrawDebugNavmesh() {
-	for (auto octantX : octants) {
-		for (auto octantY : octantX) {
-			for (auto octantZ : octantY) {
-				octantZ.DrawDebug(GetWorld());
-			}
+void ASixDOFNavmeshVolume::DrawDebugOctant(const FSixDOFOctree& tree, FOctantHandle handle) {
+	ENavigabilityStatus navigatable = tree.GetStatus(handle);
+	if (navigatable == ENavigabilityStatus::HasChildren) {
+		for (int32 i = 0; i < 8; ++i) {
+			DrawDebugOctant(tree, tree.GetChild(handle, i));
 		}
 	}
+	else if (navigatable == ENavigabilityStatus::HasSubvoxels) {
+		const int32 maskIndex = tree.Get(handle).firstChild;
+		for (int32 i = 0; i < FSixDOFOctree::SubvoxelsPerLeaf; ++i) {
+			DrawDebugOctant(tree, tree.GetSubvoxel(maskIndex, i));
+		}
+	}
+	else {
+		FColor color;
+		uint8 depth;
+		navigatable == ENavigabilityStatus::Navigable ? color = FColor::Green : color = FColor::Red;
+		if (navigatable == ENavigabilityStatus::Unloaded || navigatable == ENavigabilityStatus::Unrefined) color = FColor::Yellow;
+		navigatable == ENavigabilityStatus::Navigable ? depth = 0U : depth = 1U;
+		DrawDebugBox(GetWorld(), tree.GetCenter(handle), tree.GetExtent(handle), color, true, -1.f, depth, 2.0f);
+	}
 }
 
-void ASixDOFNavmeshVolume::DrawDebugAroundMesh(UPrimitiveComponent* mesh) {
-	TArray<FOctant*> octantsToDraw = FindOctantsAroundMesh(mesh);
-
-	for (auto octant : octantsToDraw) {
-		octant->Reset();
+void ASixDOFNavmeshVolume::DrawDebugNavmesh() {
+	const FSixDOFOctreeSnapshot snapshot = GetOctreeSnapshot();
+	if (!snapshot) return;
 
-		octant->DrawDebug(GetWorld());
+	for (int32 i = 0; i < snapshot->levels[0].Num(); ++i) {
+		DrawDebugOctant(*snapshot, FOctantHandle(0, i));
 	}
+}
+
+void ASixDOFNavmeshVolume::DrawDebugAroundMesh(UPrimitiveComponent* mesh) {
+	const FSixDOFOctreeSnapshot snapshot = GetOctreeSnapshot();
+	if (!snapshot) return;
 
-	TArray<FOctant*> newOctantsToDraw = FindOctantsAroundMesh(mesh);
-	for (auto newOctant : newOctantsToDraw) {
-		SubdivideOctree(*newOctant);
-		newOctant->DrawDebug(GetWorld());
+	// The rebuild happens on the worker, so this draws the version from before it.
+	MarkDirty(mesh->Bounds.GetBox());
+	for (auto octant : FindOctantsAroundMesh(*snapshot, mesh)) {
+		DrawDebugOctant(*snapshot, octant);
 	}
 }
\ No newline at end of file
@@ -5,19 +5,15 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Components/BoxComponent.h"
-#include "PrioritiyQueue.h"
+#include "SixDOFNavmeshSearch.h"
 #include "SixDOFNavmeshModifier.h"
 #include "SixDOFNavmeshWorker.h"
+#include "SixDOFNavmeshOctree.h"
+#include "SixDOFNavmeshData.h"
+#include "SixDOFNavmeshTileStreamer.h"
+#include "SixDOFNavmeshRasterizer.h"
 #include "SixDOFNavmeshVolume.generated.h"
 
-UENUM()
-enum class ENavigabilityStatus : uint8
-{
-	Navigable,
-	NonNavigable,
-	HasChildren
-};
-
 UENUM()
 enum class EPathfindingTaskStatus : uint8
 {
@@ -28,36 +24,30 @@ enum class EPathfindingTaskStatus : uint8
 	Failed
 };
 
-USTRUCT()
-struct FOctant
+UENUM()
+enum class EOctreeBuildBackend : uint8
 {
-	GENERATED_USTRUCT_BODY();
-
-public:
-	FOctant() {};
-
-	int32 id;
-
-	TArray<FOctant> children;
-	FOctant* parent;
-
-	FVector center;
-	FVector extent;
-
-	int32 xIndex;
-	int32 yIndex;
-	int32 zIndex;
-
-	int32 level = 0;
-	int32 index = 0;
-	float cost = 1.f;
-
-	ENavigabilityStatus navigatable = ENavigabilityStatus::Navigable;
+	// Overlap queries against the physics scene.
+	Physics,
+	// Separating axis tests against a copy of the collision geometry, independent of the physics scene.
+	Rasterizer
+};
 
-	void DrawDebug(UWorld* world);
-	void Reset();
+UENUM()
+enum class ECostModifierCombine : uint8
+{
+	// The most expensive modifier wins.
+	Max,
+	// Costs multiply.
+	Multiply,
+	// Each modifier adds its cost above the base cost of 1.
+	Add
 };
 
+// Broadcast on the game thread. Hierarchical searches report each refined stretch of the path as it is found,
+// with complete set on the last update.
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnPathUpdated, AActor*, actor, const TArray<FVector>&, path, bool, complete);
+
 USTRUCT()
 struct FPathfindingTask {
 	GENERATED_USTRUCT_BODY();
@@ -67,20 +57,43 @@ struct FPathfindingTask {
 	FVector origin;
 	FVector destination;
 
-	FOctant* originOctant;
-	FOctant* destinationOctant;
+	FOctantHandle originOctant;
+	FOctantHandle destinationOctant;
+
+	// Version of the octree the search started on, which stays alive and unchanged until the task completes.
+	FSixDOFOctreeSnapshot octree;
+	// Top-level cells on the path found that were not subdivided in that version. The search runs again once a
+	// version with all of them refined is published.
+	TArray<int32> unrefinedCells;
 
-	PrioritiyQueue<FOctant*> open;
-	TMap<FOctant*, FOctant*> closed;
+	// Borrowed from the pathfinder thread running the search, from when it picks the task up until the task completes.
+	FSixDOFSearchState* search = nullptr;
 
 	TArray<FVector> path;
 
+	// Agent layer the search is restricted to, see ASixDOFNavmeshVolume::agentRadii.
+	int32 layer = 0;
+
+	// Set while the search runs in the hierarchy, see ASixDOFNavmeshVolume::hierarchicalPathfinding.
+	bool hierarchical = false;
+	// Leaves the coarse path runs through: the origin, the leaves on either side of each cell face it crosses, and
+	// the destination. Filled once the coarse search finishes.
+	TArray<FOctantHandle> corridor;
+	// Stretch of the corridor being searched, from corridor[leg] to corridor[leg + 1], or INDEX_NONE while the
+	// coarse search runs.
+	int32 leg = INDEX_NONE;
+	// Top-level cells the current leg may pass through.
+	int32 legCells[2] = { INDEX_NONE, INDEX_NONE };
+
 	EPathfindingTaskStatus status = EPathfindingTaskStatus::NotStarted;
-	float timeTaken;
+	// When the task was scheduled, in seconds. The task times out by this, waiting included.
+	double startTime = 0.0;
+	// Time spent searching, in cycles.
+	uint64 searchCycles = 0;
 
 	FPathfindingTask() {}
-	FPathfindingTask(AActor* actor, FVector origin, FVector destination, FOctant* originOctant, FOctant* destinationOctant) :
-		actor(actor), origin(origin), destination(destination), originOctant(originOctant), destinationOctant(destinationOctant)
+	FPathfindingTask(AActor* actor, FVector origin, FVector destination, FOctantHandle originOctant, FOctantHandle destinationOctant, const FSixDOFOctreeSnapshot& octree) :
+		actor(actor), origin(origin), destination(destination), originOctant(originOctant), destinationOctant(destinationOctant), octree(octree)
 	{
 	}
 
@@ -89,10 +102,20 @@ struct FPathfindingTask {
 	}
 };
 
+class SixDOFNavmeshPathfinder;
+
+// Primitives overlapping an octant, kept inline so the recursion in SubdivideOctree does not allocate.
+typedef TArray<UPrimitiveComponent*, TInlineAllocator<8>> FOverlappingComponents;
+
 UCLASS()
 class SIXDOFNAVMESH_API ASixDOFNavmeshVolume : public AActor
 {
 	GENERATED_BODY()
+
+	friend class SixDOFNavmeshPathfinder;
+	// Automation tests, see Tests/SixDOFNavmeshVolumeTests.cpp.
+	friend class FSixDOFNavmeshBuildBackendsTest;
+	friend class FSixDOFNavmeshPathOptimalityTest;
 	
 public:	
 	// Sets default values for this actor's properties
@@ -103,16 +126,171 @@ private:
 	FCollisionQueryParams octantCollisionQueryParams;
 	FCollisionObjectQueryParams octantCollisionObjectQueryParams;
 
-	TArray<FOctant*> dynamicCollisionListeners;
-
-	void GenerateVoxelGrid();
-	void SubdivideOctree(FOctant& octant);
-	bool CheckOctantCollision(FOctant& voxel);
-
-	FOctant* FindOctantAtIndex(int32 x, int32 y, int32 z, int32 level);
-	FOctant* FindOctantAtLocation(FVector location);
-	FOctant* FindOctantWithinChildren(FVector location, TArray<FOctant>& children);
-	TArray<FOctant*> FindOctantsAroundMesh(UPrimitiveComponent* mesh);
+	struct FDynamicObstacle
+	{
+		TWeakObjectPtr<UPrimitiveComponent> component;
+		// Bounds last marked dirty.
+		FBox bounds;
+		FDelegateHandle transformUpdatedHandle;
+	};
+
+	// Game thread. Only looked at from their components' transform events, so resting obstacles cost nothing.
+	TArray<FDynamicObstacle> dynamicObstacles;
+	TQueue<FBox, EQueueMode::Mpsc> dirtyBounds;
+
+	// Worker thread. Top-level cells waiting for a rebuild, oldest first, with a flag per cell so marks are merged.
+	TArray<int32> dirtyCells;
+	TBitArray<> dirtyCellFlags;
+	// Hash of the primitives overlapping each built or rebuilt cell, so a cell is only rebuilt when they actually
+	// changed. Builds from the physics scene record none, so their cells are rebuilt on the first mark.
+	TMap<int32, uint32> cellCollisionHashes;
+	// Worker thread. Cells loaded from a tile and not checked against the dynamic obstacles since.
+	TSet<int32> bakedCells;
+
+	void InitCollisionQueryParams();
+	FIntVector GetGridSize() const;
+	FSHAHash ComputeCollisionHash();
+	void LoadBakedNavmesh();
+	void CollectModifiers();
+
+	// Lazily only classifies the top-level cells, leaving the occupied ones Unrefined.
+	void GenerateVoxelGrid(bool lazily = false);
+	// candidates are the primitives overlapping the parent, or null to query the scene.
+	void SubdivideOctree(FSixDOFOctree& tree, FOctantHandle handle, const FOverlappingComponents* candidates = nullptr);
+	// Returns the fraction of the octant's 4x4x4 sub-cells touched by a primitive's bounds, and their mask.
+	float CheckOctantCollision(FSixDOFOctree& tree, FOctantHandle handle, uint64& occupancy, const FOverlappingComponents* candidates, FOverlappingComponents& components);
+	bool FindOverlappingComponents(const FVector& center, const FVector& extent, const FOverlappingComponents* candidates, FOverlappingComponents& outComponents);
+
+	// Static collision in the volume, per region of collisionRegionSize^3 top-level cells. A region is copied on the
+	// game thread the first time the worker needs it, or every region at once by a build that reads them all, and
+	// is then read from any thread, so rebuilds on the worker never query the physics scene. Owned by the worker
+	// while it runs.
+	typedef TSharedPtr<const SixDOFNavmeshRasterizer, ESPMode::ThreadSafe> FStaticCollision;
+	TArray<FStaticCollision> staticCollision;
+	// Regions the worker is waiting for, and the regions the game thread gathered for it.
+	TQueue<int32, EQueueMode::Spsc> collisionRegionRequests;
+	TQueue<TPair<int32, FStaticCollision>, EQueueMode::Spsc> gatheredCollisionRegions;
+	// Worker thread.
+	TBitArray<> requestedCollisionRegions;
+
+	struct FDynamicCollision
+	{
+		SixDOFNavmeshRasterizer shapes;
+		// Unique ids of the obstacles, which are skipped in staticCollision where they stood when it was gathered.
+		TSet<uint32> owners;
+
+		FDynamicCollision(const FVector& origin, float cellSize, const FIntVector& gridSize) : shapes(origin, cellSize, gridSize) {}
+	};
+
+	// Shapes of the dynamic obstacles, small enough to be rebuilt on the game thread after any of them moves.
+	// Published before the bounds they dirtied, so the worker never rebuilds a cell from older shapes.
+	TSharedPtr<const FDynamicCollision, ESPMode::ThreadSafe> dynamicCollision;
+	mutable FCriticalSection dynamicCollisionLock;
+	// Game thread. Marked dirty once the shapes are published.
+	TArray<FBox> pendingObstacleBounds;
+
+	// Gathers the whole volume in one pass and shares it between every region.
+	void GatherStaticCollision();
+	// Game thread. Gathers the regions the worker asked for.
+	void TickCollisionRegionRequests();
+	FIntVector GetCollisionRegionGridSize() const;
+	int32 GetCollisionRegion(int32 cellIndex) const;
+	// Worker thread. Static collision of a cell's region, or null once the game thread has been asked for it.
+	const SixDOFNavmeshRasterizer* FindStaticCollision(int32 cellIndex);
+	void PublishDynamicCollision();
+
+	// Set while GenerateVoxelGrid reads the gathered shapes, and while the worker rebuilds a cell.
+	const SixDOFNavmeshRasterizer* rasterizer = nullptr;
+	// Set while the worker rebuilds cells.
+	const FDynamicCollision* dynamicShapes = nullptr;
+
+	// Snapshot of a modifier's box, so the worker never reads the actor.
+	struct FCostZone
+	{
+		// Unique id of the modifier, which may be gone by the time the zone is removed.
+		uint32 id;
+		FTransform transform;
+		FVector extent;
+		float cost;
+		FBox bounds;
+
+		bool operator==(const FCostZone& other) const {
+			return cost == other.cost && extent == other.extent && transform.Equals(other.transform, 0.f);
+		}
+	};
+
+	struct FCostZoneChange
+	{
+		uint32 id;
+		// Unset when the modifier was removed.
+		TOptional<FCostZone> zone;
+	};
+
+	// Game thread. Last zone sent to the worker for each modifier in modifiers.
+	TArray<FCostZone> modifierZones;
+	TQueue<FCostZoneChange, EQueueMode::Mpsc> costZoneChanges;
+	// Worker thread, keyed by the modifier's unique id.
+	TMap<uint32, FCostZone> costZones;
+
+	static FCostZone MakeCostZone(const ASixDOFNavmeshModifier* modifier);
+	void TickCostModifiers();
+	// Recomputes the cost of the nodes touching bounds from the zones overlapping them.
+	void UpdateCosts(const FBox& bounds);
+
+	// agentRadii sorted ascending. Layer i + 1 is layerRadii[i].
+	TArray<float> layerRadii;
+
+	void InitAgentLayers();
+	// Recomputes how many layers fit at the leaves inside bounds, by spreading the distance to the nearest
+	// blocked leaf outwards from the blocked leaves within reach of them.
+	void UpdateClearance(const FBox& bounds);
+
+	void OnObstacleTransformUpdated(USceneComponent* component, EUpdateTransformFlags flags, ETeleportType teleport);
+	void MarkCellsDirty(const FBox& bounds);
+	void MarkCellDirty(int32 index);
+	void RebuildCell(int32 index);
+	// Moves the cell to the front of the rebuild queue.
+	void RequestRefinement(int32 index);
+
+	// Worker thread. Cells left Unrefined by a lazy build, refined in order with what is left of the update budget.
+	TArray<int32> unrefinedCells;
+	int32 nextUnrefinedCell = 0;
+
+	// Worker thread. Cells whose portals have to be recomputed, with a flag per cell so marks are merged. Taken in
+	// batches of PortalBatchSize from the front, as far as the update budget goes.
+	TArray<int32> portalDirtyCells;
+	TBitArray<> portalDirtyFlags;
+	static constexpr int32 PortalBatchSize = 64;
+	// Worker thread. When this tick's dynamicUpdateBudget started, shared by the rebuilds and the portal updates.
+	double updateTickStart = 0.0;
+	FSixDOFSearchState portalSearch;
+
+	// Marks the cells touching bounds and the cells around them, since portals are shared across faces.
+	void MarkPortalsDirty(const FBox& bounds);
+	// Picks the leaves that paths cross a cell's +X, +Y and +Z faces through. Only reads the octree.
+	void UpdatePortalCrossings(int32 index, FCellPortals& portals);
+	// Searches the cell from each of its portals for the cost to reach the others.
+	void UpdatePortalCosts(int32 index);
+	// Without the dynamic shapes, the hash is that of the cell with none of them touching it.
+	uint32 ComputeCellCollisionHash(FOctantHandle handle, bool withDynamicShapes = true);
+	// Hashes every cell the build finished against rasterizer, which must be set.
+	void SeedCellCollisionHashes();
+
+	FOctantHandle FindOctantAtIndex(int32 x, int32 y, int32 z, int32 level);
+	FOctantHandle FindOctantAtLocation(const FSixDOFOctree& tree, FVector location);
+	// Nodes touching the mesh's bounds, with partially blocked nodes returned whole.
+	TArray<FOctantHandle> FindOctantsAroundMesh(const FSixDOFOctree& tree, UPrimitiveComponent* mesh);
+
+	void DrawDebugOctant(const FSixDOFOctree& tree, FOctantHandle handle);
+
+	// Worker thread. Set by the updates that change the octree until the next publish.
+	bool octreeChanged = false;
+	double lastPublishTime = 0.0;
+	FSixDOFOctreeSnapshot publishedOctree;
+	mutable FCriticalSection publishedOctreeLock;
+
+	// Copies the working octree into a new snapshot, which becomes the one new readers get.
+	void PublishOctree();
 
 protected:
 	// Called when the game starts or when spawned
@@ -122,26 +300,121 @@ protected:
 public:	
 	virtual void Tick(float DeltaTime) override;
 
-	TArray<TArray<TArray<FOctant>>> octants;
+	// Working copy, only touched by the worker thread once it runs. Everything else reads GetOctreeSnapshot.
+	FSixDOFOctree octree;
 	TArray<ASixDOFNavmeshModifier*> modifiers;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "SetUp")
 		float octantSize = 500.f;
+	// Builds only the top level at BeginPlay. A cell touching geometry is subdivided on the worker the first time a
+	// search reaches it, or in the background. Baking always builds the whole octree.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "SetUp")
+		bool lazySubdivision = false;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "SetUp", meta = (EditCondition = "lazySubdivision"))
+		bool backgroundRefinement = true;
+	// Includes the two finest levels, which are stored as 4x4x4 occupancy masks rather than nodes.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "SetUp", meta = (ClampMin = "2", ClampMax = "15"))
 		int32 maxSubdivisionLevel = 5;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization")
 		float percentUntilConsideredFull = 80.f;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization")
-		int32 maxPathfindingTasksPerTick = 200;
+	// Threads running path searches. 0 uses one per core, less one for the game thread.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "0"))
+		int32 numOfPathfindingThreads = 0;
+	// Searches a pathfinding thread runs at once. Further tasks wait in its queue, where idle threads can take them.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "1"))
+		int32 pathfindingTasksPerThread = 8;
+	// Time a pathfinding thread spends searching before it lets new tasks in, in microseconds, shared between its
+	// active searches in turns.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "0"))
+		float pathfindingBudget = 4000.f;
+	// Octants a search expands per turn before the next search gets one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "1"))
+		int32 pathfindingExpansionsPerTurn = 256;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization")
 		float queryTimeOutLimit = 5.f;
+	// Searches between cells further apart than neighbors first plan a route over the portals between top-level
+	// cells, then search the leaves of the cells along it one stretch at a time, reporting each stretch through
+	// onPathUpdated as it is found. Searches on agent layers above 0 always search the leaves the whole way.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization")
+		bool hierarchicalPathfinding = true;
+	// Time the worker may spend rebuilding dirty cells and updating portals per tick, in microseconds. At least one
+	// cell is rebuilt and one batch of portals updated.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "0"))
+		float dynamicUpdateBudget = 2000.f;
+	// Top-level cells along each axis of the regions static collision is gathered in when the worker first needs it.
+	UPROPERTY(EditAnywhere, Category = "Optimization", meta = (ClampMin = "1"))
+		int32 collisionRegionSize = 8;
+	// Shortest time between two published octree versions, in seconds. Each publish copies the chunks
+	// of the octree written to since the last one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "0"))
+		float snapshotInterval = 0.1f;
+	// Distance a dynamic obstacle's bounds have to move before the cells under it are rebuilt.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "0"))
+		float obstacleMoveThreshold = 10.f;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision")
 		TArray<TEnumAsByte<ECollisionChannel>> octantCollisionChannels;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision")
 		TArray<AActor*> ignoredActors;
 
+	// How the costs of overlapping modifiers combine into a node's cost.
+	UPROPERTY(EditAnywhere, Category = "Modifiers")
+		ECostModifierCombine costCombineRule = ECostModifierCombine::Max;
+
+	// Radii of the agent classes that path through this volume. Each gets a layer that keeps its searches at least
+	// that far from geometry. Point agents always get a layer of their own.
+	UPROPERTY(EditAnywhere, Category = "Agents")
+		TArray<float> agentRadii;
+
+	// Loaded instead of building at BeginPlay while it matches the collision inside the volume.
+	UPROPERTY(EditAnywhere, Category = "Baking")
+		USixDOFNavmeshData* bakedData;
+
+	UPROPERTY(EditAnywhere, Category = "Baking")
+		EOctreeBuildBackend buildBackend = EOctreeBuildBackend::Physics;
+
+	// Builds the octree in the editor world and stores it in bakedData, creating the data if there is none.
+	UFUNCTION(CallInEditor, Category = "Baking")
+		void BakeNavmesh();
+
+	// Bakes the subdivided cells as tiles of tileSize^3 top-level cells that are loaded around the players and the
+	// streaming sources at runtime, instead of keeping the whole octree resident.
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+		bool streamTiles = false;
+	UPROPERTY(EditAnywhere, Category = "Streaming", meta = (ClampMin = "1", EditCondition = "streamTiles"))
+		int32 tileSize = 8;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Streaming", meta = (EditCondition = "streamTiles"))
+		float tileStreamingRadius = 10000.f;
+	// In megabytes of serialized tile data.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Streaming", meta = (EditCondition = "streamTiles"))
+		float tileMemoryBudget = 64.f;
+	// Cost multiplier for stepping through a cell that a lazy build has not subdivided yet.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Optimization", meta = (ClampMin = "1"))
+		float unrefinedCellCost = 4.f;
+	// Cost multiplier for stepping through a cell whose tile is not loaded yet.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Streaming", meta = (ClampMin = "1", EditCondition = "streamTiles"))
+		float unloadedTileCost = 4.f;
+
+	UFUNCTION(BlueprintCallable)
+		void AddStreamingSource(AActor* source);
+	UFUNCTION(BlueprintCallable)
+		void RemoveStreamingSource(AActor* source);
+
+	// Moving primitives, see USixDOFNavObstacleComponent. Callers remove them before they are destroyed.
+	UFUNCTION(BlueprintCallable)
+		void AddDynamicObstacle(UPrimitiveComponent* component);
+	UFUNCTION(BlueprintCallable)
+		void RemoveDynamicObstacle(UPrimitiveComponent* component);
+	// Modifiers placed in the level are collected at BeginPlay. Moving one updates the nodes under its old and new box.
+	UFUNCTION(BlueprintCallable)
+		void AddCostModifier(ASixDOFNavmeshModifier* modifier);
+	UFUNCTION(BlueprintCallable)
+		void RemoveCostModifier(ASixDOFNavmeshModifier* modifier);
+	// Queues a rebuild of the top-level cells touching the bounds. Safe to call from any thread.
+	UFUNCTION(BlueprintCallable)
+		void MarkDirty(FBox bounds);
+
 	UFUNCTION(BlueprintCallable)
 		void TempFindOctant(FVector location);
 
@@ -150,11 +423,23 @@ public:
 	UFUNCTION(BlueprintCallable)
 		void DrawDebugAroundMesh(UPrimitiveComponent* mesh);
 
+	// Searches on the smallest layer whose radius is at least agentRadius.
 	UFUNCTION(BlueprintCallable)
-		bool SchedulePathfindingTask(AActor* actor, FVector destination);
+		bool SchedulePathfindingTask(AActor* actor, FVector destination, float agentRadius = 0.f);
+
+	UPROPERTY(BlueprintAssignable, Category = "Pathfinding")
+		FOnPathUpdated onPathUpdated;
+
+	// Latest published version of the octree. Safe to call from any thread, and lock held only to copy the pointer.
+	FSixDOFOctreeSnapshot GetOctreeSnapshot() const;
 
 	void TickDynamicCollisionUpdates();
-	void TickPathfindingUpdates(float deltaTime, int32 maxNumOfTasks);
+	void TickCostUpdates();
+	void TickSnapshot();
+	void TickTileStreaming();
+	// Passes on the refinements and tiles that searches asked for.
+	void TickSearchRequests();
+	void TickPortalUpdates();
 
 private:
 	int32 numOfOccupiedOctans = 0;
@@ -162,16 +447,49 @@ private:
 	int32 volumeYSize;
 	int32 volumeZSize;
 
-	SixDOFNavmeshWorker* worker;
+	SixDOFNavmeshWorker* worker = nullptr;
+	SixDOFNavmeshTileStreamer* tileStreamer = nullptr;
+
+	TArray<TWeakObjectPtr<AActor>> streamingSources;
+
 
+	TArray<SixDOFNavmeshPathfinder*> pathfinders;
+	// Game thread. Pathfinder the next task is queued on.
+	int32 nextPathfinder = 0;
+
+	// Filled by the pathfinders and emptied by the worker, which owns the dirty cells and the tile streamer.
+	TQueue<int32, EQueueMode::Mpsc> refinementRequests;
+	TQueue<FIntVector, EQueueMode::Mpsc> tileRequests;
+
+	struct FPathUpdate
+	{
+		TWeakObjectPtr<AActor> actor;
+		TArray<FVector> path;
+		bool complete;
+	};
 
-	TQueue<FPathfindingTask> newPathfindingTasks;
-	TArray<FPathfindingTask> activePathfindingTasks;
+	// Filled by the pathfinders and broadcast through onPathUpdated on the game thread.
+	TQueue<FPathUpdate, EQueueMode::Mpsc> pathUpdates;
 
-	TArray<FOctant*> FindNeighbors(FOctant* octant);
-	void GetNeighbors(FOctant* octant, TArray<FOctant*>& neighbors);
-	void AddNeighborChildren(FOctant* neighbor, TArray<int32> indices, TArray<FOctant*>& neighbors);
+	TArray<FOctantHandle> FindNeighbors(FOctantHandle handle);
+	void GetNeighbors(const FSixDOFOctree& tree, FOctantHandle handle, TArray<FOctantHandle>& neighbors);
+	void GetSubvoxelNeighbors(const FSixDOFOctree& tree, FOctantHandle handle, TArray<FOctantHandle>& neighbors);
+	void AddSubvoxelNeighbor(const FSixDOFOctree& tree, FOctantHandle link, int32 bit, TArray<FOctantHandle>& neighbors);
+	void AddNeighborChildren(const FSixDOFOctree& tree, FOctantHandle neighbor, int32 face, TArray<FOctantHandle>& neighbors);
 
 	void CalculatePath(FPathfindingTask& task);
-	void CompletePathfindingTask(int32 index);
+	// One step of the search over the portals, see hierarchicalPathfinding.
+	void CalculateCoarsePath(FPathfindingTask& task);
+	void StartPathfindingTask(FPathfindingTask& task);
+	// Searches the leaves the whole way, also when a hierarchical search turns out to need it.
+	void StartLeafSearch(FPathfindingTask& task);
+	void BuildCorridor(FPathfindingTask& task);
+	void StartLeg(FPathfindingTask& task);
+	void CompleteLeg(FPathfindingTask& task);
+	// Appends the centers along the search's path from one leaf up to, but not including, another.
+	void AppendSearchPath(FPathfindingTask& task, FOctantHandle from, FOctantHandle to);
+	void PublishPath(const FPathfindingTask& task, bool complete);
+	void RestartPathfindingTask(FPathfindingTask& task, const FSixDOFOctreeSnapshot& snapshot);
+	// Any pathfinder thread. Queues what the search has asked for since the last call.
+	void SubmitSearchRequests(FSixDOFSearchState& search);
 };
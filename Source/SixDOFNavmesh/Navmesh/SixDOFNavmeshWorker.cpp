@@ -3,10 +3,12 @@
 
 #include "SixDOFNavmeshWorker.h"
 #include "SixDOFNavmeshVolume.h"
+#include "HAL/Event.h"
 
 SixDOFNavmeshWorker::SixDOFNavmeshWorker(ASixDOFNavmeshVolume* volume) :
 	volume{ volume }
 {
+	wakeEvent = FPlatformProcess::GetSynchEventFromPool();
 	thread = FRunnableThread::Create(this, TEXT("6DOF Navmesh Worker"));
 }
 
@@ -15,6 +17,7 @@ SixDOFNavmeshWorker::~SixDOFNavmeshWorker() {
 		thread->Kill();
 		delete thread;
 	}
+	FPlatformProcess::ReturnSynchEventToPool(wakeEvent);
 }
 
 bool SixDOFNavmeshWorker::Init() {
@@ -24,10 +27,14 @@ bool SixDOFNavmeshWorker::Init() {
 
 uint32 SixDOFNavmeshWorker::Run() {
 	while (shouldRun && volume) {
+		volume->TickSearchRequests();
+		volume->TickTileStreaming();
 		volume->TickDynamicCollisionUpdates();
-		volume->TickPathfindingUpdates(tickTime, volume->maxPathfindingTasksPerTick);
+		volume->TickCostUpdates();
+		volume->TickPortalUpdates();
+		volume->TickSnapshot();
 
-		FPlatformProcess::Sleep(tickTime);
+		wakeEvent->Wait(FTimespan::FromSeconds(tickTime));
 	}
 
 	return 0;
@@ -35,5 +42,10 @@ uint32 SixDOFNavmeshWorker::Run() {
 
 void SixDOFNavmeshWorker::Stop() {
 	shouldRun = false;
+	Wake();
 	thread->WaitForCompletion();
 }
+
+void SixDOFNavmeshWorker::Wake() {
+	wakeEvent->Trigger();
+}
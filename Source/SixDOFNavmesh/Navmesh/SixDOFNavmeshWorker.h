@@ -17,8 +17,12 @@ public:
 	uint32 Run() override;
 	void Stop() override;
 
+	// Ends the wait between ticks early, for work that should not sit out the rest of it.
+	void Wake();
+
 private:
 	FRunnableThread* thread;
+	FEvent* wakeEvent;
 	ASixDOFNavmeshVolume* volume;
 	bool shouldRun = true;
 
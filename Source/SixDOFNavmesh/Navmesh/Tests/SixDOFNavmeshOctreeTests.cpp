@@ -0,0 +1,269 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshTestOctree.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace SixDOFNavmeshTests
+{
+	// The lookup FindLeafAtLocation replaced: truncate to the top-level cell, test each child's bounds inclusively
+	// in child order, and floor into the sub-voxels of the leaf.
+	FOctantHandle FindLeafByBounds(const FSixDOFOctree& tree, const FVector& location) {
+		const FVector local = (location - tree.origin) / tree.octantSize;
+		FOctantHandle handle = tree.GetTopLevel((int32)local.X, (int32)local.Y, (int32)local.Z);
+		if (!handle.IsValid()) return handle;
+
+		while (tree.GetStatus(handle) == ENavigabilityStatus::HasChildren) {
+			FOctantHandle next;
+			for (int32 i = 0; i < 8 && !next.IsValid(); ++i) {
+				const FOctantHandle child = tree.GetChild(handle, i);
+				const FVector min = tree.GetCenter(child) - tree.GetExtent(child);
+				const FVector max = tree.GetCenter(child) + tree.GetExtent(child);
+				if (min.X <= location.X && location.X <= max.X && min.Y <= location.Y && location.Y <= max.Y && min.Z <= location.Z && location.Z <= max.Z) next = child;
+			}
+			if (!next.IsValid()) return next;
+			handle = next;
+		}
+
+		if (tree.GetStatus(handle) != ENavigabilityStatus::HasSubvoxels) return handle;
+
+		const FVector subvoxel = (location - (tree.GetCenter(handle) - tree.GetExtent(handle))) / (tree.GetExtent(handle) * 0.5f);
+		const int32 x = FMath::Clamp(FMath::FloorToInt(subvoxel.X), 0, 3);
+		const int32 y = FMath::Clamp(FMath::FloorToInt(subvoxel.Y), 0, 3);
+		const int32 z = FMath::Clamp(FMath::FloorToInt(subvoxel.Z), 0, 3);
+		return tree.GetSubvoxel(tree.Get(handle).firstChild, (int32)SixDOFMorton::Encode(x, y, z));
+	}
+
+	void GatherLiveNodes(const FSixDOFOctree& tree, TArray<FOctantHandle>& outNodes) {
+		for (int32 i = 0; i < tree.levels[0].Num(); ++i) {
+			outNodes.Add(FOctantHandle(0, i));
+		}
+		for (int32 i = 0; i < outNodes.Num(); ++i) {
+			if (tree.GetStatus(outNodes[i]) != ENavigabilityStatus::HasChildren) continue;
+			for (int32 child = 0; child < 8; ++child) {
+				outNodes.Add(tree.GetChild(outNodes[i], child));
+			}
+		}
+	}
+
+	// Same shape, codes, states, costs and masks, wherever the nodes are stored.
+	bool SubtreesMatch(const FSixDOFOctree& a, FOctantHandle handleA, const FSixDOFOctree& b, FOctantHandle handleB) {
+		const FOctant& octantA = a.Get(handleA);
+		const FOctant& octantB = b.Get(handleB);
+		if (octantA.mortonCode != octantB.mortonCode || octantA.navigatable != octantB.navigatable || octantA.cost != octantB.cost) return false;
+
+		if (octantA.navigatable == ENavigabilityStatus::HasSubvoxels) return a.subvoxelMasks[octantA.firstChild] == b.subvoxelMasks[octantB.firstChild];
+		if (octantA.navigatable != ENavigabilityStatus::HasChildren) return true;
+		for (int32 i = 0; i < 8; ++i) {
+			if (!SubtreesMatch(a, a.GetChild(handleA, i), b, b.GetChild(handleB, i))) return false;
+		}
+		return true;
+	}
+
+	// Links of every live node, compared with links built from scratch.
+	int32 CountStaleLinks(const FSixDOFOctree& tree) {
+		FSixDOFOctree rebuilt = tree;
+		rebuilt.BuildLinks();
+
+		TArray<FOctantHandle> nodes;
+		GatherLiveNodes(tree, nodes);
+		int32 numOfStale = 0;
+		for (FOctantHandle node : nodes) {
+			for (int32 face = 0; face < 6; ++face) {
+				if (tree.GetLinks(node).faces[face] != rebuilt.GetLinks(node).faces[face]) numOfStale++;
+			}
+		}
+		return numOfStale;
+	}
+}
+
+using namespace SixDOFNavmeshTests;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFOctreeFindLeafAtLocationTest, "SixDOFNavmesh.Octree.FindLeafAtLocation", TestFlags)
+
+bool FSixDOFOctreeFindLeafAtLocationTest::RunTest(const FString& Parameters) {
+	FSixDOFOctree tree;
+	BuildRandomOctree(tree, 1);
+
+	TArray<FVector> locations;
+	// Every half sub-voxel, so each face between nodes, sub-voxels and top-level cells is sampled, as are the points
+	// in between and the volume's own faces.
+	const float step = tree.GetExtent(tree.GetSubvoxelLevel()).X;
+	const FIntVector numOfSteps = GridSize * FMath::RoundToInt(OctantSize / step);
+	for (int32 x = 0; x <= numOfSteps.X; ++x) {
+		for (int32 y = 0; y <= numOfSteps.Y; ++y) {
+			for (int32 z = 0; z <= numOfSteps.Z; ++z) {
+				locations.Add(Origin + FVector(FIntVector(x, y, z)) * step);
+			}
+		}
+	}
+	FRandomStream random(2);
+	for (int32 i = 0; i < 10000; ++i) {
+		locations.Add(Origin + FVector(random.FRand(), random.FRand(), random.FRand()) * FVector(GridSize) * OctantSize);
+	}
+
+	int32 numOfMismatches = 0;
+	for (const FVector& location : locations) {
+		const FOctantHandle expected = FindLeafByBounds(tree, location);
+		const FOctantHandle actual = tree.FindLeafAtLocation(location);
+		if (expected != actual && numOfMismatches++ < 10) {
+			AddError(FString::Printf(TEXT("%s resolves to level %i index %i, the bounds lookup to level %i index %i."), *location.ToString(), actual.level, actual.index, expected.level, expected.index));
+		}
+	}
+	TestEqual(TEXT("Locations resolving differently"), numOfMismatches, 0);
+
+	TestFalse(TEXT("Below the origin"), tree.FindLeafAtLocation(Origin - FVector(1.f)).IsValid());
+	TestFalse(TEXT("Past the far face"), tree.FindLeafAtLocation(Origin + FVector(GridSize) * OctantSize).IsValid());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFMortonTest, "SixDOFNavmesh.Octree.Morton", TestFlags)
+
+bool FSixDOFMortonTest::RunTest(const FString& Parameters) {
+	TestTrue(TEXT("X is the lowest bit"), SixDOFMorton::Encode(1, 0, 0) == 1);
+	TestTrue(TEXT("Y is the second bit"), SixDOFMorton::Encode(0, 1, 0) == 2);
+	TestTrue(TEXT("Z is the third bit"), SixDOFMorton::Encode(0, 0, 1) == 4);
+
+	TestTrue(TEXT("Finest coordinates reaching the last code"), SixDOFMorton::FitsGrid(FIntVector(64, 3, 1), 15));
+	TestFalse(TEXT("Finest coordinates past the last code"), SixDOFMorton::FitsGrid(FIntVector(2, 65, 1), 15));
+	TestFalse(TEXT("Coarse grid past the last code"), SixDOFMorton::FitsGrid(FIntVector(1, 1, (1 << 21) + 1), 0));
+
+	const uint32 max = 0x1fffff;
+	TArray<FIntVector> coordinates = { FIntVector(0, 0, 0), FIntVector(max, max, max), FIntVector(max, 0, max), FIntVector(1, 2, 3) };
+	FRandomStream random(1);
+	for (int32 i = 0; i < 1000; ++i) {
+		coordinates.Add(FIntVector(random.RandRange(0, max), random.RandRange(0, max), random.RandRange(0, max)));
+	}
+
+	for (const FIntVector& coordinate : coordinates) {
+		const uint64 code = SixDOFMorton::Encode(coordinate.X, coordinate.Y, coordinate.Z);
+		if (!TestTrue(FString::Printf(TEXT("%s decodes to itself"), *coordinate.ToString()), SixDOFMorton::Decode(code) == coordinate)) break;
+
+		// A parent's code is its child's without the low three bits, which are the child index.
+		const FIntVector parent(coordinate.X >> 1, coordinate.Y >> 1, coordinate.Z >> 1);
+		TestTrue(TEXT("Parent code"), code >> 3 == SixDOFMorton::Encode(parent.X, parent.Y, parent.Z));
+		TestEqual(TEXT("Child index"), (int32)(code & 7), (coordinate.X & 1) | (coordinate.Y & 1) << 1 | (coordinate.Z & 1) << 2);
+
+		for (int32 axis = 0; axis < 3; ++axis) {
+			FIntVector step(0, 0, 0);
+			step[axis] = 1;
+			if ((uint32)coordinate[axis] < max) {
+				const FIntVector next = coordinate + step;
+				TestTrue(TEXT("Incremented code"), SixDOFMorton::IncrementAxis(code, SixDOFMorton::AxisMask(axis)) == SixDOFMorton::Encode(next.X, next.Y, next.Z));
+			}
+			if (coordinate[axis] > 0) {
+				const FIntVector previous = coordinate - step;
+				TestTrue(TEXT("Decremented code"), SixDOFMorton::DecrementAxis(code, SixDOFMorton::AxisMask(axis)) == SixDOFMorton::Encode(previous.X, previous.Y, previous.Z));
+			}
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFCellPortalsFacePairTest, "SixDOFNavmesh.Octree.GetFacePair", TestFlags)
+
+bool FSixDOFCellPortalsFacePairTest::RunTest(const FString& Parameters) {
+	TBitArray<> used(false, 15);
+	for (int32 a = 0; a < 6; ++a) {
+		for (int32 b = a + 1; b < 6; ++b) {
+			const int32 pair = FCellPortals::GetFacePair(a, b);
+			TestEqual(FString::Printf(TEXT("Faces %i and %i in either order"), a, b), FCellPortals::GetFacePair(b, a), pair);
+			if (!TestTrue(FString::Printf(TEXT("Faces %i and %i index costs"), a, b), pair >= 0 && pair < 15)) continue;
+			TestFalse(FString::Printf(TEXT("Faces %i and %i share an index"), a, b), used[pair]);
+			used[pair] = true;
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFOctreeAppendTest, "SixDOFNavmesh.Octree.Append", TestFlags)
+
+bool FSixDOFOctreeAppendTest::RunTest(const FString& Parameters) {
+	FSixDOFOctree tree;
+	BuildRandomOctree(tree, 3);
+	// Shares every chunk with tree, so it also shows that writes to tree leave the copy alone.
+	const FSixDOFOctree original = tree;
+
+	TArray<int32> cells;
+	TArray<FOctantHandle> children;
+	for (int32 i = 0; i < tree.levels[0].Num(); i += 2) {
+		if (tree.GetStatus(FOctantHandle(0, i)) != ENavigabilityStatus::HasChildren) continue;
+		cells.Add(i);
+		children.Add(tree.GetChild(FOctantHandle(0, i), 7));
+	}
+	if (!TestTrue(TEXT("Subdivided cells to move"), cells.Num() > 0)) return false;
+
+	FSixDOFOctree buffer;
+	buffer.Extract(tree, cells);
+
+	TArray<int32> sizes;
+	for (const TSixDOFPool<FOctant>& level : tree.levels) {
+		sizes.Add(level.Num());
+	}
+
+	for (int32 cell : cells) {
+		tree.ReleaseSubtree(FOctantHandle(0, cell));
+		tree.Get(FOctantHandle(0, cell)).Reset();
+	}
+	for (FOctantHandle child : children) {
+		TestFalse(TEXT("Released child still valid"), tree.IsValid(child));
+	}
+
+	if (!TestTrue(TEXT("Appended"), tree.Append(buffer, cells))) return false;
+	for (int32 cell : cells) {
+		tree.RelinkSubtree(FOctantHandle(0, cell));
+	}
+
+	for (int32 level = 0; level < sizes.Num(); ++level) {
+		TestEqual(FString::Printf(TEXT("Nodes on level %i, with the released blocks reused"), level), tree.levels[level].Num(), sizes[level]);
+	}
+	for (FOctantHandle child : children) {
+		TestFalse(TEXT("Child replaced in a reused block still valid"), tree.IsValid(child));
+	}
+	for (int32 i = 0; i < tree.levels[0].Num(); ++i) {
+		TestTrue(FString::Printf(TEXT("Cell %i matches the original"), i), SubtreesMatch(tree, FOctantHandle(0, i), original, FOctantHandle(0, i)));
+	}
+	TestEqual(TEXT("Stale links"), CountStaleLinks(tree), 0);
+
+	FSixDOFOctree rebuilt;
+	BuildRandomOctree(rebuilt, 3);
+	for (int32 i = 0; i < original.levels[0].Num(); ++i) {
+		TestTrue(FString::Printf(TEXT("Shared copy of cell %i untouched"), i), SubtreesMatch(original, FOctantHandle(0, i), rebuilt, FOctantHandle(0, i)));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFOctreeRelinkTest, "SixDOFNavmesh.Octree.ReleaseAndRelink", TestFlags)
+
+bool FSixDOFOctreeRelinkTest::RunTest(const FString& Parameters) {
+	FSixDOFOctree tree;
+	BuildRandomOctree(tree, 4);
+
+	// Rebuilds cells the way the worker does: release, subdivide again in place, and relink.
+	FRandomStream random(5);
+	for (int32 i = 0; i < 20; ++i) {
+		const FOctantHandle cell(0, random.RandRange(0, tree.levels[0].Num() - 1));
+		const FOctantHandle child = tree.GetStatus(cell) == ENavigabilityStatus::HasChildren ? tree.GetChild(cell, 0) : FOctantHandle();
+
+		tree.ReleaseSubtree(cell);
+		tree.Get(cell).Reset();
+		if (child.IsValid()) TestFalse(TEXT("Released child still valid"), tree.IsValid(child));
+
+		SubdivideRandomly(tree, random, cell);
+		tree.RelinkSubtree(cell);
+		if (!TestEqual(FString::Printf(TEXT("Stale links after rebuild %i"), i), CountStaleLinks(tree), 0)) break;
+	}
+
+	// Every block is either reachable or on a free list, so rebuilding in place leaks nothing.
+	int32 numOfNodes = 0;
+	TArray<FOctantHandle> nodes;
+	GatherLiveNodes(tree, nodes);
+	for (int32 level = 0; level < tree.levels.Num(); ++level) {
+		numOfNodes += tree.levels[level].Num() - tree.freeBlocks[level].Num() * 8;
+	}
+	TestEqual(TEXT("Nodes not on a free list"), numOfNodes, nodes.Num());
+	return true;
+}
+
+#endif
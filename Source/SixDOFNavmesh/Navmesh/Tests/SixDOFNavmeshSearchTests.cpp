@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshTestOctree.h"
+#include "Navmesh/SixDOFNavmeshSearch.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+using namespace SixDOFNavmeshTests;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFSearchStateHeapTest, "SixDOFNavmesh.Search.DecreaseKey", TestFlags)
+
+bool FSixDOFSearchStateHeapTest::RunTest(const FString& Parameters) {
+	FSixDOFSearchState search;
+	FRandomStream random(1);
+
+	// Enough nodes to grow the table a few times while they are queued.
+	for (int32 round = 0; round < 3; ++round) {
+		search.Begin();
+		TMap<FOctantHandle, float> priorities;
+		for (int32 i = 0; i < 5000; ++i) {
+			const FOctantHandle handle(random.RandRange(0, 3), random.RandRange(0, 20000), random.RandRange(0, 2));
+			const float priority = random.FRandRange(0.f, 1000.f);
+
+			// A node already queued only ever moves up.
+			float& expected = priorities.FindOrAdd(handle, TNumericLimits<float>::Max());
+			expected = FMath::Min(expected, priority);
+			search.Push(handle, priority);
+		}
+
+		float previous = -1.f;
+		int32 numOfPopped = 0;
+		while (!search.IsEmpty()) {
+			const FOctantHandle top = search.Top();
+			const float* expected = priorities.Find(top);
+			if (!TestNotNull(TEXT("Popped node was pushed"), expected)) return false;
+			if (!TestTrue(TEXT("Pops in priority order"), *expected >= previous)) return false;
+			if (!TestEqual(TEXT("Node left in the heap"), search.FindOrAdd(top).heapIndex, 0)) return false;
+
+			previous = *expected;
+			search.Pop();
+			TestEqual(TEXT("Popped node's heap index"), search.Get(top).heapIndex, (int32)INDEX_NONE);
+			numOfPopped++;
+		}
+		TestEqual(TEXT("Each node popped once"), numOfPopped, priorities.Num());
+	}
+
+	// Entries of the last search are not carried into the next one.
+	const FOctantHandle handle(0, 1);
+	search.FindOrAdd(handle).g = 1.f;
+	search.Begin();
+	TestEqual(TEXT("Fresh g"), search.FindOrAdd(handle).g, TNumericLimits<float>::Max());
+	TestEqual(TEXT("Fresh heap index"), search.FindOrAdd(handle).heapIndex, (int32)INDEX_NONE);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFSearchStateReopenTest, "SixDOFNavmesh.Search.Reopen", TestFlags)
+
+bool FSixDOFSearchStateReopenTest::RunTest(const FString& Parameters) {
+	FSixDOFSearchState search;
+	search.Begin();
+
+	const FOctantHandle a(1, 10), b(1, 11), c(1, 12);
+	search.Push(a, 5.f);
+	search.Push(b, 3.f);
+	search.Push(c, 4.f);
+	search.Push(a, 6.f);
+	TestTrue(TEXT("Raising a priority is ignored"), search.Top() == b);
+	search.Push(a, 1.f);
+	TestTrue(TEXT("Lowering a priority moves the node up"), search.Top() == a);
+
+	search.Pop();
+	search.Pop();
+	TestTrue(TEXT("Remaining node"), search.Top() == c);
+	// Popped nodes go back on the list when pushed again, as A* does when it finds a cheaper way to them.
+	search.Push(a, 2.f);
+	TestTrue(TEXT("Reopened node"), search.Top() == a);
+	search.Pop();
+	search.Pop();
+	TestTrue(TEXT("Emptied"), search.IsEmpty());
+	return true;
+}
+
+#endif
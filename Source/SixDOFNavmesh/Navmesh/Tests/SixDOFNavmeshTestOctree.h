@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Navmesh/SixDOFNavmeshOctree.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Octrees the automation tests build by hand, without a world to gather collision from.
+namespace SixDOFNavmeshTests
+{
+	constexpr EAutomationTestFlags::Type TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter;
+
+	// Sizes are powers of two, so every node and sub-voxel face lies on an exactly representable coordinate.
+	const FVector Origin(-128.f, 64.f, 0.f);
+	constexpr float OctantSize = 64.f;
+	const FIntVector GridSize(2, 3, 2);
+	constexpr int32 MaxSubdivisionLevel = 4;
+
+	// Leaves a node whole, subdivides it, or masks it with random sub-voxels on the deepest level. Leaves get a random
+	// cost of at least 1, as UpdateCosts would give them.
+	inline void SubdivideRandomly(FSixDOFOctree& tree, FRandomStream& random, FOctantHandle handle) {
+		tree.Get(handle).SetCost(1.f + random.FRand() * 3.f);
+
+		if (random.FRand() < 0.3f) {
+			tree.Get(handle).navigatable = random.FRand() < 0.7f ? ENavigabilityStatus::Navigable : ENavigabilityStatus::NonNavigable;
+			return;
+		}
+
+		if ((int32)handle.level == tree.maxLevel) {
+			// Mostly open, so searches have somewhere to go.
+			const uint64 occupancy = ((uint64)random.GetUnsignedInt() << 32 | random.GetUnsignedInt()) & ((uint64)random.GetUnsignedInt() << 32 | random.GetUnsignedInt());
+			tree.Get(handle).navigatable = ENavigabilityStatus::HasSubvoxels;
+			tree.SetSubvoxels(handle, occupancy);
+			return;
+		}
+
+		// Pools may move as they grow, so nodes are looked up again after every allocation.
+		const int32 firstChild = tree.AllocateChildren(handle);
+		tree.Get(handle).navigatable = ENavigabilityStatus::HasChildren;
+		for (int32 i = 0; i < 8; ++i) {
+			const FOctantHandle child = tree.MakeHandle(handle.level + 1, firstChild + i);
+			tree.Get(child).mortonCode = (tree.Get(handle).mortonCode << 3) | i;
+			SubdivideRandomly(tree, random, child);
+		}
+	}
+
+	inline void BuildRandomOctree(FSixDOFOctree& tree, int32 seed) {
+		tree.Init(Origin, OctantSize, GridSize, MaxSubdivisionLevel);
+		for (int32 x = 0; x < GridSize.X; ++x) {
+			for (int32 y = 0; y < GridSize.Y; ++y) {
+				for (int32 z = 0; z < GridSize.Z; ++z) {
+					tree.levels[0].AddDefaulted_GetRef().mortonCode = SixDOFMorton::Encode(x, y, z);
+				}
+			}
+		}
+
+		FRandomStream random(seed);
+		for (int32 i = 0; i < tree.levels[0].Num(); ++i) {
+			SubdivideRandomly(tree, random, FOctantHandle(0, i));
+		}
+		tree.BuildLinks();
+		tree.InitLayers(1);
+	}
+}
+
+#endif
@@ -0,0 +1,216 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SixDOFNavmeshTestOctree.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Components/StaticMeshComponent.h"
+#include "Navmesh/SixDOFNavmeshVolume.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace SixDOFNavmeshTests
+{
+	// Game world that is never played, so actors spawned in it register their collision but never begin play.
+	// A volume in it builds only when a test asks, and starts no threads.
+	struct FTestWorld
+	{
+		UWorld* world;
+
+		FTestWorld() {
+			world = UWorld::CreateWorld(EWorldType::Game, false);
+			FWorldContext& context = GEngine->CreateNewWorldContext(EWorldType::Game);
+			context.SetCurrentWorld(world);
+		}
+
+		~FTestWorld() {
+			GEngine->DestroyWorldContext(world);
+			world->DestroyWorld(false);
+		}
+
+		// Set up before the component registers, since static components cannot change once they have.
+		AStaticMeshActor* SpawnShape(const TCHAR* meshPath, const FTransform& transform) {
+			AStaticMeshActor* actor = world->SpawnActorDeferred<AStaticMeshActor>(AStaticMeshActor::StaticClass(), transform);
+			UStaticMeshComponent* component = actor->GetStaticMeshComponent();
+			component->SetStaticMesh(LoadObject<UStaticMesh>(nullptr, meshPath));
+			component->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+			actor->FinishSpawning(transform);
+			return actor;
+		}
+	};
+
+	// Volume of the leaves of a whose blocked state differs from the leaf of b at their center.
+	double MeasureDisagreement(const FSixDOFOctree& a, const FSixDOFOctree& b) {
+		double volume = 0.0;
+		auto Compare = [&](FOctantHandle handle) {
+			const bool blocked = a.GetStatus(handle) == ENavigabilityStatus::NonNavigable;
+			const FOctantHandle other = b.FindLeafAtLocation(a.GetCenter(handle));
+			if (other.IsValid() && blocked != (b.GetStatus(other) == ENavigabilityStatus::NonNavigable)) volume += a.GetExtent(handle).X * a.GetExtent(handle).Y * a.GetExtent(handle).Z * 8.0;
+		};
+
+		for (int32 level = 0; level < a.levels.Num(); ++level) {
+			for (int32 i = 0; i < a.levels[level].Num(); ++i) {
+				const ENavigabilityStatus status = a.levels[level][i].navigatable;
+				if (status == ENavigabilityStatus::Navigable || status == ENavigabilityStatus::NonNavigable) Compare(FOctantHandle(level, i));
+			}
+		}
+		for (int32 i = 0; i < a.subvoxelMasks.Num(); ++i) {
+			for (int32 bit = 0; bit < FSixDOFOctree::SubvoxelsPerLeaf; ++bit) {
+				Compare(a.GetSubvoxel(i, bit));
+			}
+		}
+		return volume;
+	}
+
+	double MeasureBlockedVolume(const FSixDOFOctree& tree) {
+		double volume = 0.0;
+		for (int32 level = 0; level < tree.levels.Num(); ++level) {
+			const FVector extent = tree.GetExtent(level);
+			for (int32 i = 0; i < tree.levels[level].Num(); ++i) {
+				if (tree.levels[level][i].navigatable == ENavigabilityStatus::NonNavigable) volume += extent.X * extent.Y * extent.Z * 8.0;
+			}
+		}
+		const FVector extent = tree.GetExtent(tree.GetSubvoxelLevel());
+		for (int32 i = 0; i < tree.subvoxelMasks.Num(); ++i) {
+			volume += FPlatformMath::CountBits(tree.subvoxelMasks[i]) * extent.X * extent.Y * extent.Z * 8.0;
+		}
+		return volume;
+	}
+}
+
+using namespace SixDOFNavmeshTests;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFNavmeshBuildBackendsTest, "SixDOFNavmesh.Volume.BuildBackends", TestFlags)
+
+bool FSixDOFNavmeshBuildBackendsTest::RunTest(const FString& Parameters) {
+	FTestWorld testWorld;
+
+	// Boxes and spheres, rotated and scaled, some across cell faces, inside a volume of 4x4x4 cells.
+	testWorld.SpawnShape(TEXT("/Engine/BasicShapes/Cube.Cube"), FTransform(FRotator(0.f, 0.f, 0.f), FVector(200.f, 200.f, 200.f), FVector(1.5f)));
+	testWorld.SpawnShape(TEXT("/Engine/BasicShapes/Cube.Cube"), FTransform(FRotator(30.f, 45.f, 10.f), FVector(550.f, 300.f, 420.f), FVector(2.f, 0.5f, 1.f)));
+	testWorld.SpawnShape(TEXT("/Engine/BasicShapes/Cube.Cube"), FTransform(FRotator(0.f, 20.f, 0.f), FVector(400.f, 650.f, 100.f), FVector(6.f, 0.3f, 0.3f)));
+	testWorld.SpawnShape(TEXT("/Engine/BasicShapes/Sphere.Sphere"), FTransform(FRotator::ZeroRotator, FVector(600.f, 600.f, 600.f), FVector(2.5f)));
+	testWorld.SpawnShape(TEXT("/Engine/BasicShapes/Sphere.Sphere"), FTransform(FRotator::ZeroRotator, FVector(150.f, 500.f, 650.f), FVector(1.2f, 1.2f, 3.f)));
+
+	ASixDOFNavmeshVolume* volume = testWorld.world->SpawnActor<ASixDOFNavmeshVolume>(FVector::ZeroVector, FRotator::ZeroRotator);
+	volume->navmeshVolumeBounds->SetBoxExtent(FVector(400.f));
+	volume->octantSize = 200.f;
+	volume->maxSubdivisionLevel = 5;
+	volume->octantCollisionChannels.Add(ECC_WorldStatic);
+	volume->InitCollisionQueryParams();
+	volume->InitAgentLayers();
+
+	volume->buildBackend = EOctreeBuildBackend::Physics;
+	volume->GenerateVoxelGrid();
+	const FSixDOFOctree physicsOctree = MoveTemp(volume->octree);
+
+	volume->buildBackend = EOctreeBuildBackend::Rasterizer;
+	volume->GenerateVoxelGrid();
+	const FSixDOFOctree& rasterizerOctree = volume->octree;
+
+	if (!TestTrue(TEXT("Both backends built"), physicsOctree.levels.Num() > 0 && rasterizerOctree.levels.Num() > 0)) return false;
+
+	const FVector size = FVector(physicsOctree.gridSize) * physicsOctree.octantSize;
+	const double volumeSize = size.X * size.Y * size.Z;
+	TestTrue(TEXT("Physics backend found the shapes"), MeasureBlockedVolume(physicsOctree) > 0.01 * volumeSize);
+	TestTrue(TEXT("Rasterizer backend found the shapes"), MeasureBlockedVolume(rasterizerOctree) > 0.01 * volumeSize);
+
+	// Both test the same shapes against the same boxes, so they only differ where the physics scene's shapes are
+	// padded or rounded differently.
+	const double disagreement = (MeasureDisagreement(physicsOctree, rasterizerOctree) + MeasureDisagreement(rasterizerOctree, physicsOctree)) * 0.5 / volumeSize;
+	const double tolerance = 0.05;
+	TestTrue(FString::Printf(TEXT("Backends disagree on %f%% of the volume, within %f%%"), disagreement * 100.0, tolerance * 100.0), disagreement <= tolerance);
+
+	volume->octree.Empty();
+	volume->staticCollision.Empty();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSixDOFNavmeshPathOptimalityTest, "SixDOFNavmesh.Volume.PathOptimality", TestFlags)
+
+bool FSixDOFNavmeshPathOptimalityTest::RunTest(const FString& Parameters) {
+	FTestWorld testWorld;
+	ASixDOFNavmeshVolume* volume = testWorld.world->SpawnActor<ASixDOFNavmeshVolume>(FVector::ZeroVector, FRotator::ZeroRotator);
+	volume->hierarchicalPathfinding = false;
+
+	FSixDOFOctree tree;
+	BuildRandomOctree(tree, 6);
+	const FSixDOFOctreeSnapshot snapshot = MakeShared<const FSixDOFOctree, ESPMode::ThreadSafe>(MoveTemp(tree));
+
+	TArray<FOctantHandle> leaves;
+	snapshot->FindLeavesInBox(FBox(Origin, Origin + FVector(GridSize) * OctantSize), leaves);
+	leaves.RemoveAll([&snapshot](FOctantHandle leaf) { return snapshot->GetStatus(leaf) != ENavigabilityStatus::Navigable; });
+	if (!TestTrue(TEXT("Open leaves"), leaves.Num() > 1)) return false;
+
+	// Reference costs from a plain Dijkstra over the same graph and step costs, with a binary heap of its own.
+	struct FEntry
+	{
+		float g;
+		FOctantHandle handle;
+		bool operator<(const FEntry& other) const { return g < other.g; }
+	};
+	TMap<FOctantHandle, float> costs;
+	TArray<FEntry> open;
+	TArray<FOctantHandle> neighbors;
+	auto FindCheapestCost = [&](FOctantHandle origin, FOctantHandle destination) {
+		costs.Reset();
+		open.Reset();
+		costs.Add(origin, 0.f);
+		open.HeapPush({ 0.f, origin });
+		while (open.Num() > 0) {
+			FEntry entry;
+			open.HeapPop(entry, false);
+			if (entry.g > costs[entry.handle]) continue;
+			if (entry.handle == destination) return entry.g;
+
+			neighbors.Reset();
+			volume->GetNeighbors(*snapshot, entry.handle, neighbors);
+			for (FOctantHandle neighbor : neighbors) {
+				if (snapshot->GetStatus(neighbor) != ENavigabilityStatus::Navigable) continue;
+				const float g = entry.g + FVector::Dist(snapshot->GetCenter(entry.handle), snapshot->GetCenter(neighbor)) * snapshot->GetCost(neighbor);
+				const float* known = costs.Find(neighbor);
+				if (known && *known <= g) continue;
+				costs.Add(neighbor, g);
+				open.HeapPush({ g, neighbor });
+			}
+		}
+		return TNumericLimits<float>::Max();
+	};
+
+	FSixDOFSearchState search;
+	FRandomStream random(7);
+	for (int32 i = 0; i < 50; ++i) {
+		FPathfindingTask task;
+		task.octree = snapshot;
+		task.search = &search;
+		task.originOctant = leaves[random.RandRange(0, leaves.Num() - 1)];
+		task.destinationOctant = leaves[random.RandRange(0, leaves.Num() - 1)];
+
+		volume->StartPathfindingTask(task);
+		while (task.status == EPathfindingTaskStatus::InProgress) {
+			volume->CalculatePath(task);
+		}
+
+		const float expected = FindCheapestCost(task.originOctant, task.destinationOctant);
+		if (expected == TNumericLimits<float>::Max()) {
+			TestEqual(FString::Printf(TEXT("Search %i fails without a path"), i), (int32)task.status, (int32)EPathfindingTaskStatus::Failed);
+			continue;
+		}
+		if (!TestEqual(FString::Printf(TEXT("Search %i finds a path"), i), (int32)task.status, (int32)EPathfindingTaskStatus::Successful)) continue;
+
+		// The cost the search settled on, and the cost of the path it actually returns.
+		const float g = search.Get(task.destinationOctant).g;
+		float pathCost = 0.f;
+		for (FOctantHandle node = task.destinationOctant; node != task.originOctant; node = search.Get(node).parent) {
+			const FOctantHandle parent = search.Get(node).parent;
+			pathCost += FVector::Dist(snapshot->GetCenter(parent), snapshot->GetCenter(node)) * snapshot->GetCost(node);
+		}
+		TestEqual(FString::Printf(TEXT("Search %i cost"), i), g, expected, expected * 1e-4f + KINDA_SMALL_NUMBER);
+		TestEqual(FString::Printf(TEXT("Search %i path cost"), i), pathCost, g, g * 1e-4f + KINDA_SMALL_NUMBER);
+	}
+	return true;
+}
+
+#endif